@@ -1389,7 +1389,7 @@ cd_new_pwd(int func, LinkNode dir)
     if ((l = getshfunc("chpwd"))) {
 	fflush(stdout);
 	fflush(stderr);
-	doshfunc(l, NULL, 0, 1);
+	doshfunc("chpwd", l, NULL, 0, 1);
     }
 
     dirstacksize = getiparam("DIRSTACKSIZE");
@@ -34,6 +34,9 @@
 
 static LinkList args INIT_ZERO;
 static int doneps4 INIT_ZERO;
+#ifdef DEBUG
+static int mnerrfd = -1;	/* stderr before redirection, for closemn() */
+#endif
 static char *STTYval;
 
 /* parse string into a list */
@@ -718,6 +721,7 @@ execpline(Sublist l, int how, int last1)
     int ipipe[2], opipe[2];
     int pj, newjob;
     int old_simple_pline = simple_pline;
+    long tent = -1;
     static int lastwj, lpforked;
 
     if (!l->left)
@@ -756,6 +760,8 @@ execpline(Sublist l, int how, int last1)
 	list_pipe_job = (simple_pline ? 0 : newjob);
     }
     lastwj = lpforked = 0;
+    if (tracing && l->left->type != END && !(how & Z_ASYNC))
+	tent = tracepipe(getjobtext((void *) l->left));
     execpline2(l->left, how, opipe[0], ipipe[1], last1);
     pline_level--;
     if (how & Z_ASYNC) {
@@ -929,6 +935,10 @@ execpline(Sublist l, int how, int last1)
 	}
 	if (l->flags & PFLAG_NOT)
 	    lastval = !lastval;
+	if (tent >= 0)
+	    traceend(tent, lastval);
+	else if (tracing)
+	    traceflush();
     }
     if (!pline_level)
 	simple_pline = old_simple_pline;
@@ -1078,7 +1088,130 @@ clobber_open(struct redir *f)
 }
 
 /* size of buffer for tee and cat processes */
-#define TCBUFSIZE 4092
+#define TCBUFSIZE 65536
+
+#if defined(HAVE_SPLICE) && defined(HAVE_TEE)
+
+/* Copy len bytes from fd `from' to fd `to' through buf, which must *
+ * be at least TCBUFSIZE long.  All len bytes are consumed from     *
+ * `from' even if writing them fails, as was always the case for    *
+ * the plain read/write copy; a negative `to' discards them.        */
+
+static void
+copyout(int from, int to, char *buf, size_t len)
+{
+    ssize_t ret;
+
+    while (len > 0) {
+	ret = read(from, buf, len > TCBUFSIZE ? TCBUFSIZE : len);
+	if (ret < 0 && errno == EINTR)
+	    continue;
+	if (ret <= 0)
+	    break;
+	if (to >= 0)
+	    write(to, buf, ret);
+	len -= ret;
+    }
+}
+
+/* Move len bytes waiting in the pipe `from' to `to' without copying *
+ * them through user space.  splice() refuses some outputs, e.g.     *
+ * files opened for appending; those are copied through buf.         */
+
+static void
+spliceout(int from, int to, char *buf, size_t len)
+{
+    ssize_t ret;
+
+    while (len > 0) {
+	ret = splice(from, NULL, to, NULL, len, SPLICE_F_MOVE);
+	if (ret < 0 && errno == EINTR)
+	    continue;
+	if (ret <= 0)
+	    break;
+	len -= ret;
+    }
+    copyout(from, to, buf, len);
+}
+
+/* The tee process of a multio:  duplicate the pipe into all of the  *
+ * outputs.  For every chunk, tee() clones the pipe contents into a  *
+ * scratch pipe once for each output but the last, and the original *
+ * data is spliced into the last output.  Returns the number of      *
+ * bytes passed on, or -1 if tee() is not usable here at all.        */
+
+static off_t
+teemn(struct multio *mn, char *buf)
+{
+    int scratch[2], i, last = mn->ct - 1, err;
+    ssize_t n, m, len, got;
+    off_t total = 0;
+
+    if (pipe(scratch) < 0)
+	return -1;
+    for (;;) {
+	n = tee(mn->pipe, scratch[1], TCBUFSIZE, 0);
+	if (n < 0 && errno == EINTR)
+	    continue;
+	if (n <= 0)
+	    break;
+	spliceout(scratch[0], mn->fds[0], buf, n);
+	for (i = 1; i < last; i++) {
+	    while ((m = tee(mn->pipe, scratch[1], n, 0)) < 0 && errno == EINTR);
+	    if (m != n)
+		break;
+	    spliceout(scratch[0], mn->fds[i], buf, n);
+	}
+	if (i < last) {
+	    /* Short tee:  take this chunk off the pipe and copy it *
+	     * to the remaining outputs the ordinary way.           */
+	    if (m > 0)
+		copyout(scratch[0], -1, buf, m);
+	    for (got = 0; got < n; got += len)
+		if ((len = read(mn->pipe, buf + got, n - got)) <= 0)
+		    break;
+	    for (; i <= last; i++)
+		write(mn->fds[i], buf, got);
+	} else
+	    spliceout(mn->pipe, mn->fds[last], buf, n);
+	total += n;
+    }
+    err = errno;
+    close(scratch[0]);
+    close(scratch[1]);
+    if (n < 0 && !total && (err == EINVAL || err == ENOSYS))
+	return -1;
+    return total;
+}
+
+/* The cat process of a multio:  splice each input in turn into *
+ * the pipe, copying through buf where splice() is refused.     */
+
+static off_t
+catmn(struct multio *mn, char *buf)
+{
+    ssize_t len;
+    off_t total = 0;
+    int i;
+
+    for (i = 0; i < mn->ct; i++) {
+	while ((len = splice(mn->fds[i], NULL, mn->pipe, NULL, TCBUFSIZE,
+			     SPLICE_F_MOVE)) != 0) {
+	    if (len > 0)
+		total += len;
+	    else if (errno != EINTR)
+		break;
+	}
+	if (len < 0)
+	    while ((len = read(mn->fds[i], buf, TCBUFSIZE)) > 0) {
+		write(mn->pipe, buf, len);
+		total += len;
+	    }
+    }
+    return total;
+}
+
+#endif /* HAVE_SPLICE && HAVE_TEE */
 
 /* close an multio (success) */
 
@@ -1112,8 +1245,14 @@ void
 closemn(struct multio **mfds, int fd)
 {
     struct multio *mn = mfds[fd];
-    char buf[TCBUFSIZE];
+    char *buf;
     int len, i;
+    off_t total = -1;
+#ifdef DEBUG
+    struct timeval tv1, tv2;
+    struct timezone dummy_tz;
+    double secs;
+#endif
 
     if (fd < 0 || !mfds[fd] || mfds[fd]->ct < 2)
 	return;
@@ -1127,17 +1266,43 @@ closemn(struct multio **mfds, int fd)
     }
     /* pid == 0 */
     closeallelse(mn);
-    if (mn->rflag) {
-	/* tee process */
-	while ((len = read(mn->pipe, buf, TCBUFSIZE)) > 0)
+    buf = (char *)zalloc(TCBUFSIZE);
+#ifdef DEBUG
+    gettimeofday(&tv1, &dummy_tz);
+#endif
+#if defined(HAVE_SPLICE) && defined(HAVE_TEE)
+    total = mn->rflag ? teemn(mn, buf) : catmn(mn, buf);
+#endif
+    if (total < 0) {
+	total = 0;
+	if (mn->rflag) {
+	    /* tee process */
+	    while ((len = read(mn->pipe, buf, TCBUFSIZE)) > 0) {
+		for (i = 0; i < mn->ct; i++)
+		    write(mn->fds[i], buf, len);
+		total += len;
+	    }
+	} else {
+	    /* cat process */
 	    for (i = 0; i < mn->ct; i++)
-		write(mn->fds[i], buf, len);
-    } else {
-	/* cat process */
-	for (i = 0; i < mn->ct; i++)
-	    while ((len = read(mn->fds[i], buf, TCBUFSIZE)) > 0)
-		write(mn->pipe, buf, len);
+		while ((len = read(mn->fds[i], buf, TCBUFSIZE)) > 0) {
+		    write(mn->pipe, buf, len);
+		    total += len;
+		}
+	}
     }
+#ifdef DEBUG
+    gettimeofday(&tv2, &dummy_tz);
+    secs = (tv2.tv_sec - tv1.tv_sec) + (tv2.tv_usec - tv1.tv_usec) / 1e6;
+    if (mnerrfd >= 0) {
+	char msg[128];
+
+	sprintf(msg, "multio %s fd %d: %ld bytes, %d streams, %.3fs, %.1f MB/s\n",
+		mn->rflag ? "tee" : "cat", fd, (long)total, mn->ct, secs,
+		secs > 0 ? total / secs / 1048576 : 0.0);
+	write(mnerrfd, msg, strlen(msg));
+    }
+#endif
     _exit(0);
 }
 #if defined(WINNT) && !defined(MINGW)
@@ -1168,6 +1333,12 @@ closeallelse(struct multio *mn)
 
     for (i = 0; i < OPEN_MAX; i++)
 	if (mn->pipe != i) {
+#ifdef DEBUG
+	    /* closemn() reports its throughput on the stderr *
+	     * saved before the redirections were done        */
+	    if (i == mnerrfd)
+		continue;
+#endif
 	    for (j = 0; j < mn->ct; j++)
 		if (mn->fds[j] == i)
 		    break;
@@ -1499,7 +1670,7 @@ execcmd(Cmd cmd, int input, int output, int how, int last1)
     }
 
     /* Get the text associated with this command. */
-    if (jobbing || (how & Z_TIMED))
+    if (jobbing || tracing || (how & Z_TIMED))
 	text = getjobtext((void *) cmd);
     else
 	text = NULL;
@@ -1681,6 +1852,12 @@ execcmd(Cmd cmd, int input, int output, int how, int last1)
     /* Do process substitutions */
     spawnpipes(cmd->redir);
 
+#ifdef DEBUG
+    /* fd 2 itself may become the pipe to a tee process */
+    if (mnerrfd < 0 && nonempty(cmd->redir))
+	mnerrfd = movefd(dup(2));
+#endif
+
     /* Do io redirections */
     while (nonempty(cmd->redir)) {
 	fn = (Redir) ugetnode(cmd->redir);
@@ -1808,6 +1985,12 @@ execcmd(Cmd cmd, int input, int output, int how, int last1)
      * spawning tee/cat processes as necessary.         */
     for (i = 0; i < 10; i++)
 	closemn(mfds, i);
+#ifdef DEBUG
+    if (mnerrfd >= 0) {
+	zclose(mnerrfd);
+	mnerrfd = -1;
+    }
+#endif
 
     if (nullexec) {
 	if (nullexec == 1) {
@@ -1893,9 +2076,13 @@ execcmd(Cmd cmd, int input, int output, int how, int last1)
 #endif
 	    } else {
 		/* It's a builtin */
+		long tent = tracing ? tracestart(NULL, args) : -1;
+
 		if (forked)
 		    closem(1);
 		lastval = execbuiltin(args, (Builtin) hn);
+		if (tent >= 0)
+		    traceend(tent, lastval);
 #ifdef PATH_DEV_FD
 		closem(2);
 #endif
@@ -1974,6 +2161,12 @@ execcmd(Cmd cmd, int input, int output, int how, int last1)
     fixfds(save);
 
  done:
+#ifdef DEBUG
+    if (mnerrfd >= 0) {
+	zclose(mnerrfd);
+	mnerrfd = -1;
+    }
+#endif
     if (xtrerr != oxtrerr) {
 	fil = fileno(xtrerr);
 	fclose(xtrerr);
@@ -2249,6 +2442,46 @@ gethere(char *str, int typ)
     return s;
 }
 
+/* Try to hand a here string to the command without going through *
+ * the file system:  in an anonymous memory file where the system  *
+ * has memfd_create(), otherwise through a pipe if the whole string *
+ * fits into the pipe buffer.  The write end of the pipe is made    *
+ * non-blocking, so a string that is too long cannot deadlock us;   *
+ * we just return -1 and the caller falls back to a temp file.      */
+
+static int
+memherestr(char *t, int len)
+{
+#ifdef HAVE_MEMFD_CREATE
+    int fd;
+#endif
+#if !defined(WINNT) && defined(O_NONBLOCK)
+    int pipes[2];
+    long mode;
+#endif
+
+#ifdef HAVE_MEMFD_CREATE
+    if ((fd = memfd_create("zsh-here", 0)) != -1) {
+	if (write(fd, t, len) == len && !lseek(fd, 0, SEEK_SET))
+	    return fd;
+	close(fd);
+    }
+#endif
+#if !defined(WINNT) && defined(O_NONBLOCK)
+    if (pipe(pipes) == -1)
+	return -1;
+    if ((mode = fcntl(pipes[1], F_GETFL, 0)) != -1 &&
+	fcntl(pipes[1], F_SETFL, mode | O_NONBLOCK) != -1 &&
+	write(pipes[1], t, len) == len) {
+	close(pipes[1]);
+	return pipes[0];
+    }
+    close(pipes[0]);
+    close(pipes[1]);
+#endif
+    return -1;
+}
+
 /* open here string fd */
 
 /**/
@@ -2263,6 +2496,8 @@ getherestr(struct redir *fn)
     untokenize(t);
     unmetafy(t, &len);
     t[len++] = '\n';
+    if ((fd = memherestr(t, len)) != -1)
+	return fd;
     s = gettempname();
     if (!s || (fd = open(s, O_CREAT | O_WRONLY | O_EXCL, 0600)) == -1)
 	return -1;
@@ -2443,36 +2678,58 @@ getoutputfile(char *cmd)
     pid_t pid;
     char *nam;
     List list;
-    int fd;
+    int fd, memfd = 0;
 
     if (thisjob == -1)
 	return NULL;
     if (!(list = parsecmd(cmd)))
 	return NULL;
-    if (!(nam = gettempname()))
-	return NULL;
+#if defined(HAVE_MEMFD_CREATE) && defined(PATH_DEV_FD)
+    /* With MEMFD_SUBST the output goes to an anonymous memory file *
+     * passed to the command as /dev/fd/N, the same way as <(...).  */
+    if (isset(MEMFDSUBST) && (fd = memfd_create("zsh-subst", 0)) != -1) {
+	fd = movefd(fd);
+	nam = ncalloc(strlen(PATH_DEV_FD) + 6);
+	sprintf(nam, "%s/%d", PATH_DEV_FD, fd);
+	memfd = 1;
+	child_block();
+    } else
+#endif
+    {
+	if (!(nam = gettempname()))
+	    return NULL;
 
-    nam = ztrdup(nam);
-    PERMALLOC {
-	if (!jobtab[thisjob].filelist)
-	    jobtab[thisjob].filelist = newlinklist();
-	addlinknode(jobtab[thisjob].filelist, nam);
-    } LASTALLOC;
-    child_block();
-    fd = open(nam, O_WRONLY | O_CREAT | O_EXCL, 0600); /* create the file */
+	nam = ztrdup(nam);
+	PERMALLOC {
+	    if (!jobtab[thisjob].filelist)
+		jobtab[thisjob].filelist = newlinklist();
+	    addlinknode(jobtab[thisjob].filelist, nam);
+	} LASTALLOC;
+	child_block();
+	fd = open(nam, O_WRONLY | O_CREAT | O_EXCL, 0600); /* create the file */
+    }
 
     if (fd < 0 || (cmdoutpid = pid = zfork()) == -1) {
 	/* fork or open error */
 	child_unblock();
+	if (memfd) {
+	    zclose(fd);
+	    return NULL;
+	}
 	return nam;
     } else if (pid) {
 	int os;
 
-	close(fd);
+	if (memfd)
+	    fdtable[fd] = 2;	/* closed after the command, like <(...) */
+	else
+	    close(fd);
 	os = jobtab[thisjob].stat;
 	waitforpid(pid);
 	cmdoutval = 0;
 	jobtab[thisjob].stat = os;
+	if (memfd)
+	    lseek(fd, 0, SEEK_SET);	/* the child left the offset at the end */
 	return nam;
     }
 
@@ -2751,23 +3008,36 @@ execshfunc(Cmd cmd, Shfunc shf)
 	    zerr("function not found: %s", nam, 0);
 	    lastval = 1;
 	} else {
+	    int profiled;
+	    long tent;
+
 	    PERMALLOC {
 		shf->flags &= ~PM_UNDEFINED;
 		funcdef = shf->funcdef = (List) dupstruct(funcdef);
 	    } LASTALLOC;
 
+	    /* Running the file and any function it defines count as *
+	     * one call of nam, so neither run is profiled by itself. */
+	    profiled = profiling && startprof(nam);
+	    tent = tracing ? tracestart(nam, cmd->args) : -1;
+
 	    /* Execute the function definition, we just retrived */
-	    doshfunc(shf->funcdef, cmd->args, shf->flags, 0);
+	    doshfunc(NULL, shf->funcdef, cmd->args, shf->flags, 0);
 
 	    /* See if this file defined the autoloaded function *
 	     * by name.  If so, we execute it again.            */
 	    if ((shf = (Shfunc) shfunctab->getnode(shfunctab, nam))
 		&& shf->funcdef && shf->funcdef != funcdef)
-		doshfunc(shf->funcdef, cmd->args, shf->flags, 0);
+		doshfunc(NULL, shf->funcdef, cmd->args, shf->flags, 0);
+
+	    if (tent >= 0)
+		traceend(tent, lastval);
+	    if (profiled)
+		endprof();
 	}
     } else
 	/* Normal shell function execution */
-	doshfunc(shf->funcdef, cmd->args, shf->flags, 0);
+	doshfunc(nam, shf->funcdef, cmd->args, shf->flags, 0);
     if (!list_pipe)
 	deletefilelist(last_file_list);
 
@@ -2778,10 +3048,12 @@ execshfunc(Cmd cmd, Shfunc shf)
 
 /**/
 void
-doshfunc(List list, LinkList doshargs, int flags, int noreturnval)
+doshfunc(char *name, List list, LinkList doshargs, int flags, int noreturnval)
 /* If noreturnval is nonzero, then reset the current return *
  * value (lastval) to its value before the shell function   *
- * was executed.                                            */
+ * was executed.  name is only used for profiling and       *
+ * tracing; the call is neither profiled nor traced if it   *
+ * is NULL.                                                 */
 {
     Param pm;
     char **tab, **x, *oargv0 = NULL;
@@ -2790,8 +3062,11 @@ doshfunc(List list, LinkList doshargs, int flags, int noreturnval)
     char *s, *ou;
     void *xexitfn, *newexitfn;
     char saveopts[OPT_SIZE];
-    int obreaks = breaks;
+    int obreaks = breaks, profiled;
+    long tent;
 
+    profiled = profiling && list && startprof(name);
+    tent = tracing && list && name ? tracestart(name, doshargs) : -1;
     HEAPALLOC {
 	pushheap();
 	if (trapreturn < 0)
@@ -2903,17 +3178,20 @@ doshfunc(List list, LinkList doshargs, int flags, int noreturnval)
 
 	if (trapreturn < -1)
 	    trapreturn++;
+	if (tent >= 0)
+	    traceend(tent, lastval);
 	if (noreturnval)
 	    lastval = oldlastval;
 	popheap();
     } LASTALLOC;
+    if (profiled)
+	endprof();
 }
 
 /* Search fpath for an undefined function. */
 
-/**/
-List
-getfpfunc(char *s)
+static List
+loadfpfunc(char *s)
 {
     char **pp, buf[PATH_MAX];
     off_t len;
@@ -2962,6 +3240,22 @@ getfpfunc(char *s)
     return NULL;
 }
 
+/**/
+List
+getfpfunc(char *s)
+{
+    List r;
+    double wall, cpu;
+
+    if (!profiling)
+	return loadfpfunc(s);
+    proftime(&wall, &cpu);
+    r = loadfpfunc(s);
+    if (r)
+	profload(s, wall, cpu);
+    return r;
+}
+
 /* check to see if AUTOCD applies here */
 
 extern int doprintdir;
@@ -41,13 +41,24 @@ exists(char *s)
 #endif /* WINNT */
 }
 
+/* A match, with the file attributes it can be sorted by */
+
+struct gmatch {
+    char *name;
+    off_t size;
+    long atime;
+    long mtime;
+    long ctime;
+    long links;
+};
+
 static int mode;		/* != 0 if we are parsing glob patterns */
 static int pathpos;		/* position in pathbuf                  */
 static int matchsz;		/* size of matchbuf                     */
 static int matchct;		/* number of matches found              */
 static char pathbuf[PATH_MAX];	/* pathname buffer                      */
-static char **matchbuf;		/* array of matches                     */
-static char **matchptr;		/* &matchbuf[matchct]                   */
+static struct gmatch *matchbuf;	/* array of matches                     */
+static struct gmatch *matchptr;	/* &matchbuf[matchct]                   */
 static char *colonmod;		/* colon modifiers in qualifier list    */
 static ino_t old_ino;		/* ) remember old file and              */
 static dev_t old_dev;		/* ) position in path in case           */
@@ -69,6 +80,18 @@ typedef struct stat *Statptr;	 /* This makes the Ultrix compiler happy.  Go figu
 #define TT_KILOBYTES 2
 #define TT_MEGABYTES 3
 
+/* what the matches are sorted by */
+
+#define GS_NAME 1
+#define GS_SIZE 2
+#define GS_ATIME 3
+#define GS_MTIME 4
+#define GS_CTIME 5
+#define GS_LINKS 6
+#define GS_DESC 8		/* or'ed in for O instead of o */
+
+#define MAX_SORTS 12
+
 /* max # of qualifiers */
 
 typedef int (*TestMatchFunc) _((struct stat *, off_t));
@@ -92,6 +115,13 @@ static int qualct, qualorct;
 static int range, amc, units;
 static int gf_nullglob, gf_markdirs, gf_noglobdots, gf_listtypes, gf_follow;
 
+/* Sort order and range of matches to keep for current pattern */
+static int gf_sorts[MAX_SORTS], gf_nsorts;
+static int gf_sortstat;		/* sorting needs the files stat'ed      */
+static int gf_sortfollow;	/* sort links by the files they point to */
+static int gf_first, gf_last;	/* range of matches kept, 0 for all     */
+static int gf_heap;		/* if set, keep only this many matches  */
+
 /* Prefix, suffix for doing zle trickery */
 char *glob_pre, *glob_suf;
 
@@ -124,6 +154,102 @@ struct comp {
 #define LASTP(c)	(c->stat & C_LAST)
 #define PATHADDP(c)	(c->stat & C_PATHADD)
 
+/* Compare two matches in the order they are to appear in, as *
+ * given by the sort qualifiers, and by name if they are equal. */
+
+static int
+gmatchcmp(struct gmatch *a, struct gmatch *b)
+{
+    int i, r = 0;
+
+    for (i = 0; !r && i < gf_nsorts; i++) {
+	switch (gf_sorts[i] & ~GS_DESC) {
+	case GS_NAME:
+	    r = notstrcmp(&b->name, &a->name);
+	    break;
+	case GS_SIZE:
+	    r = a->size < b->size ? -1 : a->size > b->size;
+	    break;
+	case GS_ATIME:
+	    r = a->atime > b->atime ? -1 : a->atime < b->atime;
+	    break;
+	case GS_MTIME:
+	    r = a->mtime > b->mtime ? -1 : a->mtime < b->mtime;
+	    break;
+	case GS_CTIME:
+	    r = a->ctime > b->ctime ? -1 : a->ctime < b->ctime;
+	    break;
+	case GS_LINKS:
+	    r = a->links < b->links ? -1 : a->links > b->links;
+	    break;
+	}
+	if (gf_sorts[i] & GS_DESC)
+	    r = -r;
+    }
+    return r ? r : notstrcmp(&b->name, &a->name);
+}
+
+/* As gmatchcmp(), but counting from the end of the order when *
+ * the range to keep is given from the end.                    */
+
+static int
+gmatchsel(struct gmatch *a, struct gmatch *b)
+{
+    return gf_first < 0 ? gmatchcmp(b, a) : gmatchcmp(a, b);
+}
+
+/* Add a match when only the first gf_heap of them in order are  *
+ * wanted.  matchbuf is kept as a heap with the last of the ones *
+ * kept so far at the top, so that each new match need only be   *
+ * compared with that to be dropped, or take its place and sink  *
+ * to its level.  The names kept are permanent copies, so that   *
+ * memory only grows with the number kept.                       */
+
+static void
+heapinsert(struct gmatch *g)
+{
+    int i, j;
+
+    if (matchct == gf_heap) {
+	if (gmatchsel(g, matchbuf) >= 0)
+	    return;
+	zsfree(matchbuf->name);
+	for (i = 0; (j = 2 * i + 1) < matchct; i = j) {
+	    if (j + 1 < matchct && gmatchsel(matchbuf + j + 1, matchbuf + j) > 0)
+		j++;
+	    if (gmatchsel(matchbuf + j, g) <= 0)
+		break;
+	    matchbuf[i] = matchbuf[j];
+	}
+    } else {
+	for (i = matchct; i && gmatchsel(matchbuf + (j = (i - 1) / 2), g) < 0;
+	     i = j)
+	    matchbuf[i] = matchbuf[j];
+	if (++matchct == matchsz)
+	    matchbuf = (struct gmatch *)realloc((char *)matchbuf,
+				sizeof(struct gmatch) * (matchsz *= 2));
+    }
+    matchbuf[i] = *g;
+    matchbuf[i].name = ztrdup(g->name);
+}
+
+/* get an index of the range qualifier, negative from the end */
+
+static int
+qgetindex(char **s)
+{
+    int v;
+
+    if (**s == '-') {
+	(*s)++;
+	v = -qgetnum(s);
+    } else
+	v = qgetnum(s);
+    if (!v && !errflag)
+	zerr("bad range in glob qualifier", NULL, 0);
+    return v;
+}
+
 /* Main entry point to the globbing code for filename globbing. *
  * np points to a node in the list list which will be expanded  *
  * into a series of nodes.                                      */
@@ -164,6 +290,8 @@ glob(LinkList list, LinkNode np)
     gf_markdirs = isset(MARKDIRS);
     gf_listtypes = gf_follow = 0;
     gf_noglobdots = unset(GLOBDOTS);
+    gf_nsorts = gf_sortstat = gf_sortfollow = 0;
+    gf_first = gf_last = gf_heap = 0;
     if (str[sl - 1] == Outpar) {	/* check for qualifiers */
 	char *s;
 	int sense = 0;			/* bit 0 for match (0)/don't match (1)   */
@@ -411,10 +539,74 @@ glob(LinkList list, LinkNode np)
 			}
 			break;
 		    case 'o':
-			/* Match octal mode of file exactly. *
-			 * Currently undocumented.           */
-			func = qualeqflags;
-			data = qgetoctnum(&s);
+			if (idigit(*s)) {
+			    /* Match octal mode of file exactly. *
+			     * Currently undocumented.           */
+			    func = qualeqflags;
+			    data = qgetoctnum(&s);
+			    break;
+			}
+			/* FALLTHROUGH */
+		    case 'O':
+			/* Sort by name, size, times or number of links; *
+			 * O sorts in the opposite order to o.           */
+			if (gf_nsorts == MAX_SORTS) {
+			    zerr("too many glob sort specifiers", NULL, 0);
+			    break;
+			}
+			switch (*s) {
+			case 'n':
+			    gf_sorts[gf_nsorts] = GS_NAME;
+			    break;
+			case 'L':
+			    gf_sorts[gf_nsorts] = GS_SIZE;
+			    break;
+			case 'a':
+			    gf_sorts[gf_nsorts] = GS_ATIME;
+			    break;
+			case 'm':
+			    gf_sorts[gf_nsorts] = GS_MTIME;
+			    break;
+			case 'c':
+			    gf_sorts[gf_nsorts] = GS_CTIME;
+			    break;
+			case 'l':
+			    gf_sorts[gf_nsorts] = GS_LINKS;
+			    break;
+			default:
+			    zerr("unknown sort specifier", NULL, 0);
+			    break;
+			}
+			if (errflag)
+			    break;
+			if (s[-1] == 'O')
+			    gf_sorts[gf_nsorts] |= GS_DESC;
+			if (*s++ != 'n') {
+			    gf_sortstat = 1;
+			    gf_sortfollow = sense & 2;
+			}
+			gf_nsorts++;
+			break;
+		    case Inbrack:
+		    case '[':
+			/* Keep only a range of the sorted matches */
+			gf_first = gf_last = qgetindex(&s);
+			if (*s == ',' || *s == Comma) {
+			    s++;
+			    gf_last = qgetindex(&s);
+			}
+			if (*s == ']' || *s == Outbrack)
+			    s++;
+			else if (!errflag)
+			    zerr("missing ] in glob qualifier", NULL, 0);
+			/* From the same end, the matches wanted are *
+			 * among the first few counted from there.   */
+			if (gf_first > 0 && gf_last > 0)
+			    gf_heap = gf_last;
+			else if (gf_first < 0 && gf_last < 0)
+			    gf_heap = -gf_first;
+			else
+			    gf_heap = 0;
 			break;
 		    case 'M':
 			/* Mark directories with a / */
@@ -529,7 +721,8 @@ glob(LinkList list, LinkNode np)
 
     /* Initialise receptacle for matched files, *
      * expanded by insert() where necessary.    */
-    matchptr = matchbuf = (char **)zalloc((matchsz = 16) * sizeof(char *));
+    matchptr = matchbuf = (struct gmatch *)
+	zalloc((matchsz = 16) * sizeof(struct gmatch));
     matchct = 0;
 
     /* Initialise memory of last file matched */
@@ -541,6 +734,42 @@ glob(LinkList list, LinkNode np)
      * matchbuf.  This is the only top-level call to scanner(). */
     scanner(q);
 
+    if (gf_heap) {
+	/* Move the names insert() kept onto the heap */
+	for (matchptr = matchbuf; matchptr < matchbuf + matchct; matchptr++) {
+	    char *n = matchptr->name;
+
+	    matchptr->name = dupstring(n);
+	    zsfree(n);
+	}
+    }
+    /* Sort arguments in to lexical (and possibly numeric) order, *
+     * or as the sort qualifiers say.                             */
+    qsort((void *) & matchbuf[0], matchct, sizeof(struct gmatch),
+	       (int (*) _((const void *, const void *)))gmatchcmp);
+    matchptr = matchbuf;
+    if (gf_first) {
+	/* Keep just the range of matches asked for.  If only some *
+	 * were kept by insert(), the range counted from the same  *
+	 * end of those is the same.                               */
+	int first = gf_first, last = gf_last;
+
+	if (first < 0)
+	    first += matchct + 1;
+	if (last < 0)
+	    last += matchct + 1;
+	if (first < 1)
+	    first = 1;
+	if (last > matchct)
+	    last = matchct;
+	if (first > last)
+	    matchct = 0;
+	else {
+	    matchptr += first - 1;
+	    matchct = last - first + 1;
+	}
+    }
+
     /* Deal with failures to match depending on options */
     if (matchct)
 	badcshglob |= 2;	/* at least one cmd. line expansion O.K. */
@@ -553,18 +782,16 @@ glob(LinkList list, LinkNode np)
 	    return;
 	} else {
 	    /* treat as an ordinary string */
-	    untokenize(*matchptr++ = dupstring(ostr));
+	    untokenize(matchbuf->name = dupstring(ostr));
+	    matchptr = matchbuf;
 	    matchct = 1;
 	}
     }
-    /* Sort arguments in to lexical (and possibly numeric) order. *
-     * This is reversed to facilitate insertion into the list.    */
-    qsort((void *) & matchbuf[0], matchct, sizeof(char *),
-	       (int (*) _((const void *, const void *)))notstrcmp);
 
-    matchptr = matchbuf;
-    while (matchct--)		/* insert matches in the arg list */
-	insertlinknode(list, node, *matchptr++);
+    /* Insert matches in the arg list; each goes before the last */
+    matchptr += matchct;
+    while (matchct--)
+	insertlinknode(list, node, (--matchptr)->name);
     free(matchbuf);
 }
 
@@ -642,13 +869,14 @@ notstrcmp(char **a, char **b)
     return cmp;
 }
 
-/* add a match to the list */
+/* add a match to the list; s may be a temporary buffer */
 
 /**/
 void
 insert(char *s)
 {
     struct stat buf, buf2, *bp;
+    struct gmatch g;
     char *news = s;
     int statted = 0;
 
@@ -715,15 +943,49 @@ insert(char *s)
 	if (!t)
 	    return;
     }
+    memset(&g, 0, sizeof(g));
+    if (gf_sortstat) {
+	/* Get the attributes the matches are sorted by */
+	if (!statted)
+	    statted = lstat(unmeta(s), &buf) ? -1 : 1;
+	if (statted > 0) {
+	    if (gf_sortfollow && statted != 2) {
+#ifndef WINNT
+		if (!S_ISLNK(buf.st_mode) || stat(unmeta(s), &buf2))
+#else
+		if (stat(unmeta(s), &buf2))
+#endif /* WINNT */
+		    memcpy(&buf2, &buf, sizeof(buf));
+		statted = 2;
+	    }
+	    bp = gf_sortfollow ? &buf2 : &buf;
+	    g.size = bp->st_size;
+	    g.atime = bp->st_atime;
+	    g.mtime = bp->st_mtime;
+	    g.ctime = bp->st_ctime;
+	    g.links = bp->st_nlink;
+	}
+    }
     if (colonmod) {
 	/* Handle the remainder of the qualifer:  e.g. (:r:s/foo/bar/). */
-	s = colonmod;
-	modify(&news, &s);
+	char *mod = colonmod;
+
+	if (news == s)
+	    news = dupstring(s);
+	modify(&news, &mod);
     }
-    *matchptr++ = news;
+    g.name = news;
+    if (gf_heap) {
+	/* this copies the name only if it is kept */
+	heapinsert(&g);
+	return;
+    }
+    if (news == s)
+	g.name = dupstring(s);
+    *matchptr++ = g;
     if (++matchct == matchsz) {
-	matchbuf = (char **)realloc((char *)matchbuf,
-				    sizeof(char **) * (matchsz *= 2));
+	matchbuf = (struct gmatch *)realloc((char *)matchbuf,
+				    sizeof(struct gmatch) * (matchsz *= 2));
 
 	matchptr = matchbuf + matchct;
     }
@@ -1554,13 +1816,13 @@ scanner(Complist q)
 		pathbuf[pathpos = oppos] = '\0';
 	    } else if (!*c->str) {
 		if (exists(getfullpath(".")))
-		    insert(dupstring(pathbuf));
+		    insert(pathbuf);
 	    } else {
 		/* Last path section.  See if there's a file there. */
 		char *s;
 
 		if (exists(s = getfullpath(c->str)))
-		    insert(dupstring(s));
+		    insert(s);
 	    }
 	} else {
 	    /* Do pattern matching on current path section. */
@@ -1621,9 +1883,13 @@ scanner(Complist q)
 			if (addpath(fn))
 			    scanner((q->closure) ? q : q->next);	/* scan next level */
 			pathbuf[pathpos = oppos] = '\0';
+		    } else if (pathpos + strlen(fn) < PATH_MAX) {
+			/* if the last filename component, just add it */
+			strcpy(pathbuf + pathpos, fn);
+			insert(pathbuf);
+			pathbuf[pathpos] = '\0';
 		    } else
 			insert(dyncat(pathbuf, fn));
-		    /* if the last filename component, just add it */
 		}
 	    }
 	    closedir(lock);
@@ -2280,13 +2546,12 @@ void
 remnulargs(char *s)
 {
     int nl = *s;
-    char *t = s;
+    char *t = s, *o = s;
 
-    while (*s)
-	if (INULL(*s))
-	    chuck(s);
-	else
-	    s++;
+    for (; *s; s++)
+	if (!INULL(*s))
+	    *o++ = *s;
+    *o = '\0';
     if (!*t && nl) {
 	t[0] = Nularg;
 	t[1] = '\0';
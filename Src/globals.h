@@ -369,6 +369,12 @@ EXTERN char *scriptname INIT_ZERO;        /* name of script being sourced */
 
 EXTERN zlong lineno INIT_ZERO;		/* $LINENO       */
 EXTERN zlong shlvl INIT_ZERO;		/* $SHLVL        */
+
+/* screen updates done by zle, and the bytes and write()s they took */
+
+EXTERN zlong zlerefreshes INIT_ZERO;		/* $ZLE_REFRESHES      */
+EXTERN zlong zlerefreshbytes INIT_ZERO;		/* $ZLE_REFRESH_BYTES  */
+EXTERN zlong zlerefreshwrites INIT_ZERO;	/* $ZLE_REFRESH_WRITES */
  
 EXTERN long lastval2 INIT_ZERO;
 
@@ -579,6 +585,14 @@ EXTERN int sigtrapped[VSIGCOUNT] INIT_ZERO_STRUCT;
 
 EXTERN List sigfuncs[VSIGCOUNT] INIT_ZERO_STRUCT;
 
+/* nonzero if shell functions are being profiled (zprof -e) */
+
+EXTERN int profiling INIT_ZERO;
+
+/* nonzero if commands are being recorded in the trace buffer (ztrace -e) */
+
+EXTERN int tracing INIT_ZERO;
+
 #ifdef DEBUG
 EXTERN int alloc_stackp INIT_ZERO;
 #endif
@@ -731,6 +745,7 @@ struct option optns[OPT_SIZE] = {
     {"beep", 			x'B', 0,    OPT_ALL},
     {"bgnice", 			'6',  0,    OPT_EMULATE|OPT_NONBOURNE},
     {"braceccl", 		0,    0,    0},
+    {"bracketedpaste", 		0,    0,    OPT_ALL},
     {"bsdecho", 		0,    0,    OPT_EMULATE|OPT_SH},
     {"cdablevars", 		'T',  0,    0},
     {"chaselinks", 		'w',  0,    0},
@@ -781,6 +796,7 @@ struct option optns[OPT_SIZE] = {
     {"magicequalsubst", 	0,    0,    0},
     {"mailwarning", 		'U',  0,    0},
     {"markdirs", 		'8',  'X',  0},
+    {"memfdsubst", 		0,    0,    0},
     {"menucomplete", 		'Y',  0,    0},
     {"monitor", 		'm',  'm',  OPT_SPECIAL},
     {"multios", 		0,    0,    OPT_EMULATE|OPT_ZSH},
@@ -79,6 +79,7 @@ addhashnode(HashTable ht, char *nam, void *nodeptr)
 
     hn = (HashNode) nodeptr;
     hn->nam = nam;
+    ht->gen++;
 
     hashval = ht->hash(hn->nam) % ht->hsize;
     hp = ht->nodes[hashval];
@@ -186,6 +187,7 @@ removehashnode(HashTable ht, char *nam)
     if (!strcmp(hp->nam, nam)) {
 	ht->nodes[hashval] = hp->next;
 	ht->ct--;
+	ht->gen++;
 	return hp;
     }
 
@@ -196,6 +198,7 @@ removehashnode(HashTable ht, char *nam)
 	if (!strcmp(hp->nam, nam)) {
 	    hq->next = hp->next;
 	    ht->ct--;
+	    ht->gen++;
 	    return hp;
 	}
     }
@@ -447,6 +450,7 @@ emptyhashtable(HashTable ht, int newsize)
     }
 
     ht->ct = 0;
+    ht->gen++;
 }
 
 /* Print info about hash table */
@@ -135,6 +135,9 @@ IPDEF4("$", &mypid),
 IPDEF4("?", &lastval),
 IPDEF4("LINENO", &lineno),
 IPDEF4("PPID", &ppid),
+IPDEF4("ZLE_REFRESHES", &zlerefreshes),
+IPDEF4("ZLE_REFRESH_BYTES", &zlerefreshbytes),
+IPDEF4("ZLE_REFRESH_WRITES", &zlerefreshwrites),
 
 #define IPDEF5(A,B,F) {NULL,A,PM_INTEGER|PM_SPECIAL,BR(NULL),SFN(F),GFN(intvargetfn),10,(void *)B,NULL,NULL,NULL,0}
 IPDEF5("COLUMNS", &columns, zlevarsetfn),
@@ -207,6 +210,9 @@ IPDEF9("watch", &watch, "WATCH"),
 IPDEF9("path", &path, "PATH"),
 IPDEF9("psvar", &psvar, "PSVAR"),
 
+#define IPDEF10(A,B) {NULL,A,PM_ARRAY|PM_READONLY|PM_SPECIAL|PM_DONTIMPORT,BR(NULL),SFN(nullsetfn),GFN(B),0,NULL,NULL,NULL,NULL,0}
+IPDEF10("PROMPTTIMES", prompttimesgetfn),
+
 {NULL, NULL}
 };
 #undef BR
@@ -314,11 +320,7 @@ struct builtin builtins[] =
     {NULL, "local", BINF_TYPEOPTS | BINF_MAGICEQUALS | BINF_PSPECIAL, bin_typeset, 0, -1, 0, "LRUZilrtu", NULL},
     {NULL, "log", 0, bin_log, 0, 0, 0, NULL, NULL},
     {NULL, "logout", 0, bin_break, 0, 1, BIN_LOGOUT, NULL, NULL},
-
-#if defined(ZSH_MEM) & defined(ZSH_MEM_DEBUG)
-    {NULL, "mem", 0, bin_mem, 0, 0, 0, "v", NULL},
-#endif
-
+    {NULL, "mem", 0, bin_mem, 0, 0, 0, "cdemv", NULL},
     {NULL, "popd", 0, bin_cd, 0, 2, BIN_POPD, NULL, NULL},
     {NULL, "print", BINF_PRINTOPTS, bin_print, 0, -1, BIN_PRINT, "RDPnrslzNu0123456789pioOcm-", NULL},
     {NULL, "pushd", 0, bin_cd, 0, 2, BIN_PUSHD, NULL, NULL},
@@ -361,6 +363,8 @@ struct builtin builtins[] =
     {NULL, "whence", 0, bin_whence, 0, -1, 0, "acmpvf", NULL},
     {NULL, "where", 0, bin_whence, 0, -1, 0, "pm", "ca"},
     {NULL, "which", 0, bin_whence, 0, -1, 0, "amp", "c"},
+    {NULL, "zprof", 0, bin_zprof, 0, 0, 0, "cdem", NULL},
+    {NULL, "ztrace", 0, bin_ztrace, 0, 1, 0, "bcdes", NULL},
     {NULL, NULL}
 };
 #else
@@ -151,6 +151,48 @@ hgetc(void)
     return c;
 }
 
+/* Read in one go the run of characters at the head of the input for *
+ * which ok[] is set, as if by calling hgetc() for each of them, and  *
+ * set *runp to the first of them.  The number read is returned; it   *
+ * is zero whenever a character might need hgetc()'s own treatment:   *
+ * while history is being expanded into the line, when the input came *
+ * from a history expansion, or at a bangchar, or a backslash that    *
+ * could quote one, or a possible ^foo^bar at the start of a line.    *
+ * The ok[] table should leave out newlines and tokens, which         *
+ * ingetc() handles specially.                                        */
+
+/**/
+int
+hgetrun(unsigned char *ok, char **runp)
+{
+    int hsub = !stophist && !(inbufflags & INP_ALIAS);
+    char *p, *s, *e;
+    int n;
+
+    if (lexstop || expanding || (inbufflags & INP_HIST) ||
+	(hsub && isfirstch) || !(n = inpeek(&p)))
+	return 0;
+    for (s = p, e = p + n; s < e && ok[STOUC(*s)]; s++)
+	if (STOUC(*s) == bangchar || (hsub && *s == '\\'))
+	    break;
+    if (!(n = s - p))
+	return 0;
+    inskip(n);
+    qbang = 0;
+    if (chline && !errflag) {
+	if (hptr - chline + n >= hlinesz) {
+	    int oldsiz = hptr - chline;
+
+	    chline = realloc(chline, hlinesz = oldsiz + n + 16);
+	    hptr = chline + oldsiz;
+	}
+	memcpy(hptr, p, n);
+	hptr += n;
+    }
+    *runp = p;
+    return n;
+}
+
 /**/
 void
 safeinungetc(int c)
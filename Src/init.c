@@ -67,6 +67,7 @@ main(int argc, char **argv)
 #endif /* MINGW */
 #endif /* WINNT */
 
+    startupinit();
     global_permalloc();
 
     /*
@@ -105,15 +106,26 @@ main(int argc, char **argv)
     opts[MONITOR] = 1;   /* may be unset in init_io() */
     opts[PRIVILEGED] = (getuid() != geteuid() || getgid() != getegid());
     opts[USEZLE] = 1;   /* may be unset in init_io() */
+    startupphase("parseargs");
     parseargs(argv);   /* sets INTERACTIVE, SHINSTDIN and SINGLECOMMAND */
 
     SHTTY = -1;
+    startupphase("init_io");
     init_io();
+    startupphase("setupvals");
     setupvals();
+    startupphase("init_signals");
     init_signals();
     global_heapalloc();
+    startupphase("run_init_scripts");
     run_init_scripts();
+    startupphase("init_misc");
     init_misc();
+    /* The times are only reported at the first prompt */
+    if (interact)
+	startupphase("first prompt");
+    else
+	startupdone();
 
     for (;;) {
 	do
@@ -180,7 +192,7 @@ loop(int toplevel, int justonce)
 		    if (he && he->text)
 			addlinknode(args, he->text);
 		} LASTALLOC;
-		doshfunc(prelist, args, 0, 1);
+		doshfunc("preexec", prelist, args, 0, 1);
 		freelinklist(args, (FreeFunc) NULL);
 		errflag = 0;
 	    }
@@ -620,6 +632,7 @@ setupvals(void)
     struct passwd *pswd;
     struct timezone dummy_tz;
     char *ptr;
+    int ent;
 #ifdef HAVE_GETRLIMIT
     int i;
 #endif
@@ -731,7 +744,9 @@ setupvals(void)
 
     createreswdtable();     /* create hash table for reserved words    */
     createaliastable();     /* create hash table for aliases           */
+    ent = startupbegin("createcmdnamtable");
     createcmdnamtable();    /* create hash table for external commands */
+    startupend(ent);
     createshfunctable();    /* create hash table for shell functions   */
     createbuiltintable();   /* create hash table for builtin commands  */
     createcompctltable();   /* create hash table for compctls          */
@@ -923,7 +938,7 @@ int
 source(char *s)
 {
     int tempfd, fd, cj, oldlineno;
-    int oldshst, osubsh, oloops;
+    int oldshst, osubsh, oloops, ent;
     FILE *obshin;
     char *old_scriptname = scriptname;
 
@@ -948,9 +963,11 @@ source(char *s)
     dosetopt(SHINSTDIN, 0, 1);
     scriptname = s;
 
+    ent = startupbegin(s);
     sourcelevel++;
     loop(0, 0);			/* loop through the file to be sourced        */
     sourcelevel--;
+    startupend(ent);
     fclose(bshin);
     fdtable[SHIN] = 0;
 
@@ -220,7 +220,9 @@ inputline(void)
 	     */
 	    char *pptbuf;
 	    int pptlen;
+	    double t = tracetime();
 	    pptbuf = putprompt((char *)ingetcpmptl, &pptlen, NULL, 1);
+	    endprompttimes(t);
 	    write(2, (WRITE_ARG_2_T)pptbuf, pptlen);
 	    free(pptbuf);
 	}
@@ -372,6 +374,35 @@ inungetc(int c)
     }
 }
 
+/*
+ * Look at what is left of the current input buffer without reading it:
+ * *p is set to the next character and the number of characters that
+ * follow it in this buffer is returned.  This lets the lexer take a
+ * run of ordinary characters in one go; whatever it takes must then be
+ * consumed with inskip().  Nothing here looks beyond the current
+ * buffer, so anything which ingetc() would treat specially is left for
+ * it to deal with as usual.
+ */
+
+/**/
+int
+inpeek(char **p)
+{
+    *p = inbufptr;
+    return inbufleft;
+}
+
+/* Consume n characters already looked at with inpeek(). */
+
+/**/
+void
+inskip(int n)
+{
+    inbufptr += n;
+    inbufleft -= n;
+    inbufct -= n;
+}
+
 /* stuff a whole file into the input queue and print it */
 
 /**/
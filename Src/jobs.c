@@ -178,9 +178,60 @@ handle_sub(int job, int fg)
 
 /* Update status of process that we have just WAIT'ed for */
 
+static long clktck = 0;
+
+static void
+set_clktck(void)
+{
+#ifdef _SC_CLK_TCK
+    if (!clktck)
+	/* fetch clock ticks per second from *
+	 * sysconf only the first time       */
+	clktck = sysconf(_SC_CLK_TCK);
+#else
+# ifdef __NeXT__
+    /* NeXTStep 3.3 defines CLK_TCK wrongly */
+    clktck = 60;
+# else
+#  ifdef CLK_TCK
+    clktck = CLK_TCK;
+#  else
+#   ifdef HZ
+     clktck = HZ;
+#   else
+     clktck = 60;
+#   endif
+#  endif
+# endif
+#endif
+}
+
+#ifdef HAVE_GETRUSAGE
+
+/* Fill in a timeinfo from getrusage() or wait4() */
+
+/**/
+void
+rusagetimes(struct rusage *ru, struct timeinfo *ti)
+{
+    ti->ut = ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1000000.0;
+    ti->st = ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1000000.0;
+    ti->maxrss = ru->ru_maxrss;
+    ti->majflt = ru->ru_majflt;
+    ti->minflt = ru->ru_minflt;
+    ti->nvcsw = ru->ru_nvcsw;
+    ti->nivcsw = ru->ru_nivcsw;
+    ti->inblock = ru->ru_inblock;
+    ti->oublock = ru->ru_oublock;
+}
+#endif
+
+/* Record the exit (or stop) of a process.  ti is the resource usage *
+ * of the process if WAIT could tell us, else NULL.                  */
+
 /**/
 void
-update_process(Process pn, int status)
+update_process(Process pn, int status, struct timeinfo *ti)
 {
     struct timezone dummy_tz;
     long childs, childu;
@@ -190,10 +241,19 @@ update_process(Process pn, int status)
     times(&shtms);                          /* get time-accounting info          */
 
     pn->status = status;                    /* save the status returned by WAIT  */
-    pn->ti.st  = shtms.tms_cstime - childs; /* compute process system space time */
-    pn->ti.ut  = shtms.tms_cutime - childu; /* compute process user space time   */
+    if (ti)
+	pn->ti = *ti;
+    else {
+	set_clktck();
+	memset(&pn->ti, 0, sizeof(pn->ti));
+	/* compute process system and user space time */
+	pn->ti.st = (shtms.tms_cstime - childs) / (double) clktck;
+	pn->ti.ut = (shtms.tms_cutime - childu) / (double) clktck;
+    }
 
     gettimeofday(&pn->endtime, &dummy_tz);  /* record time process exited        */
+    if (tracing)
+	traceexit(pn);
 }
 
 /* Update status of job, possibly printing it */
@@ -614,6 +674,8 @@ addproc(pid_t pid, char *text)
     gettimeofday(&pn->bgtime, &dummy_tz);
     pn->status = SP_RUNNING;
     pn->next = NULL;
+    if (tracing)
+	tracefork(pn);
 
     /* if this is the first process we are adding to *
      * the job, then it's the group leader.          */
@@ -794,34 +856,6 @@ spawnjob(void)
     thisjob = -1;
 }
 
-static long clktck = 0;
-
-static void
-set_clktck(void)
-{
-#ifdef _SC_CLK_TCK
-    if (!clktck)
-	/* fetch clock ticks per second from *
-	 * sysconf only the first time       */
-	clktck = sysconf(_SC_CLK_TCK);
-#else
-# ifdef __NeXT__
-    /* NeXTStep 3.3 defines CLK_TCK wrongly */
-    clktck = 60;
-# else
-#  ifdef CLK_TCK
-    clktck = CLK_TCK;
-#  else
-#   ifdef HZ
-     clktck = HZ;
-#   else
-     clktck = 60;
-#   endif
-#  endif
-# endif
-#endif
-}
-
 /* Check whether shell should report the amount of time consumed   *
  * by job.  This will be the case if we have preceded the command  *
  * with the keyword time, or if REPORTTIME is non-negative and the *
@@ -832,8 +866,10 @@ int
 should_report_time(Job j)
 {
     Value v;
+    Process pn;
     char *s = "REPORTTIME";
     int reporttime;
+    double cpu = 0;
 
     /* if the time keyword was used */
     if (j->stat & STAT_TIMED)
@@ -846,8 +882,9 @@ should_report_time(Job j)
     if (!j->procs)
 	return 0;
 
-    set_clktck();
-    return ((j->procs->ti.ut + j->procs->ti.st) / clktck >= reporttime);
+    for (pn = j->procs; pn; pn = pn->next)
+	cpu += pn->ti.ut + pn->ti.st;
+    return cpu >= reporttime;
 }
 
 /**/
@@ -867,6 +904,16 @@ printhhmmss(double secs)
 	fprintf(stderr,           "%.3f",              secs);
 }
 
+/* print a time in seconds as whole milliseconds (u == 'm') *
+ * or microseconds (u == 'u')                                 */
+
+static void
+printunits(double secs, int u)
+{
+    fprintf(stderr, "%.0f%s", secs * (u == 'm' ? 1e3 : 1e6),
+	    u == 'm' ? "ms" : "us");
+}
+
 /**/
 void
 printtime(struct timeval *real, struct timeinfo *ti, char *desc)
@@ -878,18 +925,12 @@ printtime(struct timeval *real, struct timeinfo *ti, char *desc)
     if (!desc)
 	desc = "";
 
-    set_clktck();
     /* go ahead and compute these, since almost every TIMEFMT will have them */
     elapsed_time = real->tv_sec + real->tv_usec / 1000000.0;
-    user_time    = ti->ut / (double) clktck;
-    system_time  = ti->st / (double) clktck;
-#ifndef WINNT
-    percent      =  100.0 * (ti->ut + ti->st)
-	/ (clktck * real->tv_sec + clktck * real->tv_usec / 1000000.0);
-#else
-    percent      =  100 * (ti->ut + ti->st)
-	/ (clktck * real->tv_sec + clktck * real->tv_usec / 1000000);
-#endif /* WINNT */
+    user_time    = ti->ut;
+    system_time  = ti->st;
+    percent      = elapsed_time > 0 ?
+	100.0 * (user_time + system_time) / elapsed_time : 0;
 
     if (!(s = getsparam("TIMEFMT")))
 	s = DEFAULT_TIMEFMT;
@@ -923,6 +964,45 @@ printtime(struct timeval *real, struct timeinfo *ti, char *desc)
 		    break;
 		}
 		break;
+	    case 'm':
+	    case 'u':
+		/* milliseconds and microseconds */
+		switch (s[1]) {
+		case 'E':
+		    printunits(elapsed_time, *s++);
+		    break;
+		case 'U':
+		    printunits(user_time, *s++);
+		    break;
+		case 'S':
+		    printunits(system_time, *s++);
+		    break;
+		default:
+		    fprintf(stderr, "%%%c", *s);
+		    break;
+		}
+		break;
+	    case 'M':
+		fprintf(stderr, "%ld", ti->maxrss);
+		break;
+	    case 'F':
+		fprintf(stderr, "%ld", ti->majflt);
+		break;
+	    case 'R':
+		fprintf(stderr, "%ld", ti->minflt);
+		break;
+	    case 'w':
+		fprintf(stderr, "%ld", ti->nvcsw);
+		break;
+	    case 'c':
+		fprintf(stderr, "%ld", ti->nivcsw);
+		break;
+	    case 'I':
+		fprintf(stderr, "%ld", ti->inblock);
+		break;
+	    case 'O':
+		fprintf(stderr, "%ld", ti->oublock);
+		break;
 	    case 'P':
 		fprintf(stderr, "%d%%", percent);
 		break;
@@ -944,16 +1024,49 @@ printtime(struct timeval *real, struct timeinfo *ti, char *desc)
     fflush(stderr);
 }
 
+/* Report the time of a job.  The times and resource usage of the *
+ * processes in a pipeline are added up, and the elapsed time runs *
+ * from the start of the first to the end of the last.             */
+
 /**/
 void
 dumptime(Job jn)
 {
     Process pn;
+    struct timeinfo ti;
+    struct timeval *start, *end;
+    char desc[JOBTEXTSIZE * 2];
+    int len;
 
-    if (!jn->procs)
+    if (!(pn = jn->procs))
 	return;
-    for (pn = jn->procs; pn; pn = pn->next)
+    if (!pn->next) {
 	printtime(dtime(&dtimeval, &pn->bgtime, &pn->endtime), &pn->ti, pn->text);
+	return;
+    }
+    memset(&ti, 0, sizeof(ti));
+    start = &pn->bgtime;
+    end = &pn->endtime;
+    *desc = '\0';
+    for (; pn; pn = pn->next) {
+	ti.ut += pn->ti.ut;
+	ti.st += pn->ti.st;
+	ti.maxrss += pn->ti.maxrss;
+	ti.majflt += pn->ti.majflt;
+	ti.minflt += pn->ti.minflt;
+	ti.nvcsw += pn->ti.nvcsw;
+	ti.nivcsw += pn->ti.nivcsw;
+	ti.inblock += pn->ti.inblock;
+	ti.oublock += pn->ti.oublock;
+	if (timercmp(&pn->bgtime, start, <))
+	    start = &pn->bgtime;
+	if (timercmp(&pn->endtime, end, >))
+	    end = &pn->endtime;
+	len = strlen(desc);
+	if (len + strlen(pn->text) + 3 < sizeof(desc))
+	    sprintf(desc + len, *desc ? " | %s" : "%s", pn->text);
+    }
+    printtime(dtime(&dtimeval, start, end), &ti, desc);
 }
 
 /**/
@@ -963,16 +1076,30 @@ shelltime(void)
 #ifndef WINNT
     struct timeinfo ti;
     struct timezone dummy_tz;
+#ifdef HAVE_GETRUSAGE
+    struct rusage ru;
+
+    gettimeofday(&now, &dummy_tz);
+    getrusage(RUSAGE_SELF, &ru);
+    rusagetimes(&ru, &ti);
+    printtime(dtime(&dtimeval, &shtimer, &now), &ti, "shell");
+    getrusage(RUSAGE_CHILDREN, &ru);
+    rusagetimes(&ru, &ti);
+    printtime(dtime(&dtimeval, &shtimer, &now), &ti, "children");
+#else
     struct tms buf;
 
+    set_clktck();
+    memset(&ti, 0, sizeof(ti));
     times(&buf);
-    ti.ut = buf.tms_utime;
-    ti.st = buf.tms_stime;
+    ti.ut = buf.tms_utime / (double) clktck;
+    ti.st = buf.tms_stime / (double) clktck;
     gettimeofday(&now, &dummy_tz);
     printtime(dtime(&dtimeval, &shtimer, &now), &ti, "shell");
-    ti.ut = buf.tms_cutime;
-    ti.st = buf.tms_cstime;
+    ti.ut = buf.tms_cutime / (double) clktck;
+    ti.st = buf.tms_cstime / (double) clktck;
     printtime(dtime(&dtimeval, &shtimer, &now), &ti, "children");
+#endif
 #endif /* WINNT */
 }
 
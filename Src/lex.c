@@ -281,6 +281,14 @@ unsigned char lexact1[256] INIT_ZERO_STRUCT,
 	lexact2[256] INIT_ZERO_STRUCT,
 	lextok2[256] INIT_ZERO_STRUCT;
 
+/* Characters which gettokstr() just copies to the token unchanged, *
+ * outside quotes, inside single quotes and inside double quotes.   *
+ * Runs of these are taken from the input in one go by hgetrun().   */
+
+static unsigned char lexrun2[256] INIT_ZERO_STRUCT,
+	lexrunsq[256] INIT_ZERO_STRUCT,
+	lexrundq[256] INIT_ZERO_STRUCT;
+
 /**/
 void
 initlextabs(void)
@@ -308,6 +316,15 @@ initlextabs(void)
     lextok2['~'] = Tilde;
     lextok2['#'] = Pound;
     lextok2['^'] = Hat;
+
+    for (t0 = 0; t0 != 256; t0++) {
+	int plain = t0 && t0 != '\n' && !itok(t0);
+
+	lexrun2[t0] = plain && !inblank(t0) &&
+	    lexact2[t0] == LX2_OTHER && lextok2[t0] == t0;
+	lexrunsq[t0] = plain && t0 != '\'';
+	lexrundq[t0] = plain && !strchr("\\$}`'()[]\"", t0);
+    }
 }
 
 /* initialize lexical state */
@@ -340,6 +357,25 @@ add(int c)
     }
 }
 
+/* add n chars to the string buffer */
+
+static void
+addrun(char *s, int n)
+{
+    if (len + n >= bsiz) {
+	int newbsiz;
+
+	newbsiz = bsiz * 8;
+	while (newbsiz <= len + n || newbsiz < inbufct)
+	    newbsiz *= 2;
+	bptr = len + (tokstr = (char *)hrealloc(tokstr, bsiz, newbsiz));
+	bsiz = newbsiz;
+    }
+    memcpy(bptr, s, n);
+    bptr += n;
+    len += n;
+}
+
 #define SETPARBEGIN {if (zleparse && !(inbufflags & INP_ALIAS) && cs >= ll+1-inbufct) parbegin = inbufct;}
 #define SETPAREND {\
 	    if (zleparse && !(inbufflags & INP_ALIAS) && parbegin != -1 && parend == -1) {\
@@ -646,7 +682,8 @@ gettokstr(int c, int sub)
 {
     int bct = 0, pct = 0, brct = 0, fdpar = 0;
     int intpos = 1, in_brace_param = 0;
-    int peek, inquote, unmatched = 0;
+    int peek, inquote, unmatched = 0, n;
+    char *run;
 #ifdef DEBUG
     int ocmdsp = cmdsp;
 #endif
@@ -962,6 +999,8 @@ gettokstr(int c, int sub)
 			    break;
 		    }
 		    add(c);
+		    if ((n = hgetrun(lexrunsq, &run)))
+			addrun(run, n);
 		}
 		ALLOWHIST
 		if (c != '\'') {
@@ -1032,6 +1071,11 @@ gettokstr(int c, int sub)
 	    break;
 	}
 	add(c);
+	if ((n = hgetrun(lexrun2, &run))) {
+	    addrun(run, n);
+	    intpos = intpos > n ? intpos - n : 0;
+	    fdpar = 0;
+	}
 	c = hgetc();
 	if (intpos)
 	    intpos--;
@@ -1066,7 +1110,8 @@ int
 dquote_parse(char endchar, int sub)
 {
     int pct = 0, brct = 0, bct = 0, intick = 0, err = 0;
-    int c;
+    int c, n;
+    char *run;
     int math = endchar == ')' || endchar == ']';
     int zlemath = math && cs > ll + addedx - inbufct;
 
@@ -1173,6 +1218,8 @@ dquote_parse(char endchar, int sub)
 	if (err || lexstop)
 	    break;
 	add(c);
+	if ((n = hgetrun(lexrundq, &run)))
+	    addrun(run, n);
     }
     if (intick == 2)
 	ALLOWHIST
@@ -52,7 +52,7 @@ insertlinknode(LinkList list, LinkNode node, void *dat)
     LinkNode tmp;
 
     tmp = node->next;
-    node->next = (LinkNode) alloc(sizeof *tmp);
+    node->next = useheap ? hnodealloc() : (LinkNode) zalloc(sizeof *tmp);
     node->next->last = node;
     node->next->dat = dat;
     node->next->next = tmp;
@@ -29,6 +29,23 @@
 
 #include "zsh.h"
 
+/* this is where the allocators are defined, so calls to them *
+ * are not redirected to the versions that note the caller    */
+
+#undef zalloc
+#undef zcalloc
+#undef zrealloc
+#undef ztrdup
+#undef zfree
+#undef zsfree
+#undef halloc
+#undef hcalloc
+#undef dupstring
+#undef alloc
+#undef ncalloc
+#undef free
+#undef realloc
+
 void *(*alloc) _((size_t)) INIT_ZERO;
 void *(*ncalloc) _((size_t)) INIT_ZERO;
 
@@ -135,9 +152,8 @@ struct heap {
     struct heap *next;		/* next one                                  */
     size_t used;		/* bytes used from the heap                  */
     struct heapstack *sp;	/* used by pushheap() to save the value used */
-#ifdef ZSH_64_BIT_TYPE
-    size_t dummy;		/* Make sure sizeof(heap) is a multiple of 8 */
-#endif
+    size_t size;		/* size of the arena; this also makes sure   */
+				/* sizeof(heap) is a multiple of 8           */
 #define arena(X)	((char *) (X) + sizeof(struct heap))
 };
 
@@ -145,6 +161,24 @@ struct heap {
 
 Heap heaps;
 
+/* first heap worth looking at for free space, see halloc() */
+
+static Heap fheap;
+
+/* Link list nodes on the heap are handed out from chunks of NODECHUNK *
+ * nodes, as expansions of big globs and arrays create huge numbers of *
+ * them.  The current chunk is forgotten whenever the heaps are reset. */
+
+#define NODECHUNK 64
+
+static LinkNode nodepool;
+static int nodepoolct;
+
+/* number and total size of the zsh heaps, and the largest total *
+ * size since the allocation profile was last cleared            */
+
+static long heapct, heapbytes, maxheapbytes;
+
 /* save states of zsh heaps */
 
 /**/
@@ -177,6 +211,7 @@ freeheap(void)
 #if defined(ZSH_MEM) && defined(ZSH_MEM_DEBUG)
     h_free++;
 #endif
+    fheap = NULL;
     for (h = heaps; h; h = h->next) {
 #ifdef ZSH_MEM_DEBUG
 	if (h->sp)
@@ -185,7 +220,10 @@ freeheap(void)
 	    memset(arena(h), 0xff, h->used);
 #endif
 	h->used = h->sp ? h->sp->used : 0;
+	if (!fheap && h->used < HEAP_ARENA_SIZE)
+	    fheap = h;
     }
+    nodepoolct = 0;
 }
 
 /* reset heap to previous state and destroy state information */
@@ -201,6 +239,7 @@ popheap(void)
     h_pop++;
 #endif
 
+    fheap = NULL;
     for (h = heaps; h; h = hn) {
 	hn = h->next;
 	if ((hs = h->sp)) {
@@ -209,16 +248,22 @@ popheap(void)
 	    memset(arena(h) + hs->used, 0xff, h->used - hs->used);
 #endif
 	    h->used = hs->used;
+	    if (!fheap && h->used < HEAP_ARENA_SIZE)
+		fheap = h;
 	    zfree(hs, sizeof(*hs));
 
 	    hl = h;
-	} else
+	} else {
+	    heapct--;
+	    heapbytes -= h->size;
 	    zfree(h, HEAPSIZE);
+	}
     }
     if (hl)
 	hl->next = NULL;
     else
 	heaps = NULL;
+    nodepoolct = 0;
 }
 
 /* allocate memory from the current memory pool */
@@ -236,13 +281,18 @@ halloc(size_t size)
     h_m[size < 1024 ? (size / H_ISIZE) : 1024]++;
 #endif
 
-    /* find a heap with enough free space */
+    /* find a heap with enough free space; the heaps before fheap  *
+     * are full, or nearly so, and need not be tried.  A heap which *
+     * cannot take the request is left behind for good, so that a   *
+     * long chain of nearly full heaps is not walked over and over. */
 
-    for (h = heaps; h; h = h->next) {
+    for (h = (fheap ? fheap : heaps); h; h = h->next) {
 	if (HEAP_ARENA_SIZE >= (n = size + h->used)) {
 	    h->used = n;
 	    return arena(h) + n - size;
 	}
+	if (h == fheap)
+	    fheap = h->next;
     }
 
     {
@@ -267,19 +317,38 @@ halloc(size_t size)
 #endif
 
 	h->used = size;
+	h->size = n;
 	h->next = NULL;
 	h->sp = NULL;
+	heapct++;
+	if ((heapbytes += n) > maxheapbytes)
+	    maxheapbytes = heapbytes;
 
 	if (hp)
 	    hp->next = h;
 	else
 	    heaps = h;
+	fheap = h;
 
 	unqueue_signals();
 	return arena(h);
     }
 }
 
+/* allocate a link list node from the current memory pool */
+
+/**/
+LinkNode
+hnodealloc(void)
+{
+    if (!nodepoolct) {
+	nodepool = (LinkNode) halloc(NODECHUNK * sizeof(struct linknode));
+	nodepoolct = NODECHUNK;
+    }
+    nodepoolct--;
+    return nodepool++;
+}
+
 /* allocate memory from the current memory pool and clear it */
 
 /**/
@@ -396,6 +465,356 @@ ztrdup(const char *s)
     return t;
 }
 
+/* The allocation profile.  While it is switched on with `mem -e', *
+ * the allocators called through the macros in zsh.h note where    *
+ * they were called from.  For each call site the number and size  *
+ * of the blocks allocated from the zsh heaps and permanently, and  *
+ * of the blocks freed there, is kept.  Permanent blocks are also   *
+ * entered in a table by address until they are freed, so that the *
+ * number of bytes still in use from each site, and the most there  *
+ * have been, can be given.  The profile's own memory comes from    *
+ * malloc() and is not counted.                                     */
+
+struct memsite {
+    struct memsite *next;	/* next in hash chain                  */
+    char *file;			/* where the call is, or NULL          */
+    int line;
+    long allocs, bytes;		/* permanent blocks allocated here     */
+    long frees, freed;		/* blocks freed here                   */
+    long live, maxlive;		/* bytes allocated here not yet freed  */
+    long hallocs, hbytes;	/* blocks allocated here from the heap */
+};
+
+struct memblock {
+    void *p;			/* address of block, NULL if slot free */
+    size_t size;
+    struct memsite *site;	/* where it was allocated              */
+};
+
+#define MEMSITES 509
+#define MEMBLOCKS 4096
+
+static int memprof;
+static struct memsite **memsites;
+static int memsitect;
+
+static struct memblock *memblocks;
+static long memblockct, memblocksize;
+static long memlive, maxmemlive;
+
+static struct memsite *
+getmemsite(char *file, int line)
+{
+    struct memsite *ms, **tab;
+    unsigned long h = ((unsigned long) file >> 2) + line * 31;
+
+    if (!memsites && !(memsites = (struct memsite **)
+		       calloc(MEMSITES, sizeof(*memsites))))
+	return NULL;
+    tab = memsites + h % MEMSITES;
+    for (ms = *tab; ms; ms = ms->next)
+	if (ms->file == file && ms->line == line)
+	    return ms;
+    if (!(ms = (struct memsite *) calloc(1, sizeof(*ms))))
+	return NULL;
+    ms->file = file;
+    ms->line = line;
+    ms->next = *tab;
+    *tab = ms;
+    memsitect++;
+    return ms;
+}
+
+/* The table of blocks uses open addressing with linear probing. */
+
+#define MEMHASH(P) ((((unsigned long) (P) >> 4) * 2654435761UL) & \
+		    (memblocksize - 1))
+
+static long
+findmemblock(void *p)
+{
+    long i;
+
+    if (!memblocks)
+	return -1;
+    for (i = MEMHASH(p); memblocks[i].p; i = (i + 1) & (memblocksize - 1))
+	if (memblocks[i].p == p)
+	    return i;
+    return -1;
+}
+
+/* Remove slot i, moving up any later entries in its run which would *
+ * then no longer be found.                                          */
+
+static void
+delmemblock(long i)
+{
+    long j = i, k, mask = memblocksize - 1;
+
+    memblockct--;
+    for (;;) {
+	memblocks[i].p = NULL;
+	for (;;) {
+	    j = (j + 1) & mask;
+	    if (!memblocks[j].p)
+		return;
+	    k = MEMHASH(memblocks[j].p);
+	    if (i <= j ? (k <= i || k > j) : (k <= i && k > j))
+		break;
+	}
+	memblocks[i] = memblocks[j];
+	i = j;
+    }
+}
+
+/* Forget a permanent block, charging it to the site it came from. */
+
+static void
+memunlive(long i)
+{
+    struct memsite *ms = memblocks[i].site;
+
+    ms->live -= memblocks[i].size;
+    memlive -= memblocks[i].size;
+    delmemblock(i);
+}
+
+static void
+addmemblock(void *p, size_t size, struct memsite *ms)
+{
+    long i;
+
+    /* a block freed with free() may have been handed out again */
+    if ((i = findmemblock(p)) >= 0)
+	memunlive(i);
+    if ((memblockct + 1) * 2 > memblocksize) {
+	struct memblock *old = memblocks;
+	long oldsize = memblocksize;
+
+	memblocksize = oldsize ? oldsize * 2 : MEMBLOCKS;
+	if (!(memblocks = (struct memblock *)
+	      calloc(memblocksize, sizeof(*memblocks)))) {
+	    memblocks = old;
+	    memblocksize = oldsize;
+	    return;
+	}
+	for (i = 0; i < oldsize; i++)
+	    if (old[i].p) {
+		long j = MEMHASH(old[i].p);
+
+		while (memblocks[j].p)
+		    j = (j + 1) & (memblocksize - 1);
+		memblocks[j] = old[i];
+	    }
+	free(old);
+    }
+    for (i = MEMHASH(p); memblocks[i].p; i = (i + 1) & (memblocksize - 1));
+    memblocks[i].p = p;
+    memblocks[i].size = size;
+    memblocks[i].site = ms;
+    memblockct++;
+    if ((ms->live += size) > ms->maxlive)
+	ms->maxlive = ms->live;
+    if ((memlive += size) > maxmemlive)
+	maxmemlive = memlive;
+}
+
+static void
+profalloc(void *p, size_t size, char *file, int line)
+{
+    struct memsite *ms;
+
+    queue_signals();
+    if ((ms = getmemsite(file, line))) {
+	ms->allocs++;
+	ms->bytes += size;
+	addmemblock(p, size, ms);
+    }
+    unqueue_signals();
+}
+
+static void
+proffree(void *p, size_t size, char *file, int line)
+{
+    struct memsite *ms;
+    long i;
+
+    queue_signals();
+    if ((i = findmemblock(p)) >= 0) {
+	size = memblocks[i].size;
+	memunlive(i);
+    }
+    if ((ms = getmemsite(file, line))) {
+	ms->frees++;
+	ms->freed += size;
+    }
+    unqueue_signals();
+}
+
+static void
+profhalloc(size_t size, char *file, int line)
+{
+    struct memsite *ms;
+
+    queue_signals();
+    if ((ms = getmemsite(file, line))) {
+	ms->hallocs++;
+	ms->hbytes += size;
+    }
+    unqueue_signals();
+}
+
+/* Throw away the table of blocks in use, and with it the counts of *
+ * bytes in use, which cannot be kept up while profiling is off.    */
+
+static void
+clearmemblocks(void)
+{
+    int i;
+    struct memsite *ms;
+
+    free(memblocks);
+    memblocks = NULL;
+    memblockct = memblocksize = 0;
+    memlive = 0;
+    if (memsites)
+	for (i = 0; i < MEMSITES; i++)
+	    for (ms = memsites[i]; ms; ms = ms->next)
+		ms->live = 0;
+}
+
+static void
+clearmemprof(void)
+{
+    int i;
+    struct memsite *ms, *next;
+
+    clearmemblocks();
+    if (memsites) {
+	for (i = 0; i < MEMSITES; i++)
+	    for (ms = memsites[i]; ms; ms = next) {
+		next = ms->next;
+		free(ms);
+	    }
+	free(memsites);
+	memsites = NULL;
+    }
+    memsitect = 0;
+    maxmemlive = 0;
+    maxheapbytes = heapbytes;
+}
+
+/* The allocators as called from the rest of the shell. */
+
+/**/
+void *
+zalloc_at(size_t size, char *file, int line)
+{
+    void *ptr = zalloc(size);
+
+    if (memprof)
+	profalloc(ptr, size ? size : 1, file, line);
+    return ptr;
+}
+
+/**/
+void *
+zcalloc_at(size_t size, char *file, int line)
+{
+    void *ptr = zcalloc(size);
+
+    if (memprof)
+	profalloc(ptr, size ? size : 1, file, line);
+    return ptr;
+}
+
+/**/
+void *
+zrealloc_at(void *ptr, size_t size, char *file, int line)
+{
+    if (memprof && ptr)
+	proffree(ptr, 0, file, line);
+    ptr = zrealloc(ptr, size);
+    if (memprof && ptr)
+	profalloc(ptr, size, file, line);
+    return ptr;
+}
+
+/**/
+char *
+ztrdup_at(const char *s, char *file, int line)
+{
+    char *t = ztrdup(s);
+
+    if (memprof && t)
+	profalloc(t, strlen(t) + 1, file, line);
+    return t;
+}
+
+/**/
+void
+zfree_at(void *p, int sz, char *file, int line)
+{
+    if (memprof && p)
+	proffree(p, sz, file, line);
+    zfree(p, sz);
+}
+
+/**/
+void
+zsfree_at(char *p, char *file, int line)
+{
+    if (memprof && p)
+	proffree(p, strlen(p) + 1, file, line);
+    zsfree(p);
+}
+
+/**/
+void *
+halloc_at(size_t size, char *file, int line)
+{
+    if (memprof)
+	profhalloc((size + H_ISIZE - 1) & ~(H_ISIZE - 1), file, line);
+    return halloc(size);
+}
+
+/**/
+void *
+hcalloc_at(size_t size, char *file, int line)
+{
+    if (memprof)
+	profhalloc((size + H_ISIZE - 1) & ~(H_ISIZE - 1), file, line);
+    return hcalloc(size);
+}
+
+/**/
+void *
+ncalloc_at(size_t size, char *file, int line)
+{
+    return useheap ? halloc_at(size, file, line) : zalloc_at(size, file, line);
+}
+
+/**/
+void *
+alloc_at(size_t size, char *file, int line)
+{
+    return useheap ? hcalloc_at(size, file, line) :
+	zcalloc_at(size, file, line);
+}
+
+/**/
+char *
+dupstring_at(const char *s, char *file, int line)
+{
+    char *t;
+
+    if (!s)
+	return NULL;
+    t = (char *)ncalloc_at(strlen((char *)s) + 1, file, line);
+    strcpy(t, s);
+    return t;
+}
+
 #ifdef ZSH_MEM
 
 /*
@@ -648,6 +1067,14 @@ malloc(MALLOC_ARG_T size)
 	    hfp->next = hf->next;
 	else
 	    heaps = hf->next;
+	/* don't let halloc() start at it or hand out nodes from it */
+	if (hf == fheap)
+	    fheap = hf->next;
+	if ((char *)nodepool >= arena(hf) &&
+	    (char *)nodepool < arena(hf) + hf->size)
+	    nodepoolct = 0;
+	heapct--;
+	heapbytes -= hf->size;
 	/* now we simply free it and than search the free list again */
 	zfree(hf, HEAPSIZE);
 
@@ -1041,9 +1468,8 @@ calloc(MALLOC_ARG_T n, MALLOC_ARG_T size)
 
 #ifdef ZSH_MEM_DEBUG
 
-/**/
-int
-bin_mem(char *name, char **argv, char *ops, int func)
+static void
+memdump(char *ops)
 {
     int i, ii, fi, ui, j;
     struct m_hdr *m, *mf, *ms;
@@ -1172,8 +1598,7 @@ bin_mem(char *name, char **argv, char *ops, int func)
 		   (long)i * H_ISIZE * h_m[i]);
     if (h_m[1024])
 	printf("big\t%d\n", h_m[1024]);
-
-    return 0;
+    putchar('\n');
 }
 
 #endif
@@ -1197,3 +1622,87 @@ zsfree(char *p)
 }
 
 #endif
+
+/* Order call sites by bytes in use, then by bytes allocated. */
+
+static int
+memsitecmp(const void *a, const void *b)
+{
+    struct memsite *x = *(struct memsite **) a, *y = *(struct memsite **) b;
+
+    if (x->live != y->live)
+	return x->live < y->live ? 1 : -1;
+    if (x->bytes + x->hbytes != y->bytes + y->hbytes)
+	return x->bytes + x->hbytes < y->bytes + y->hbytes ? 1 : -1;
+    return x->line - y->line;
+}
+
+static void
+printmemprof(int machine)
+{
+    struct memsite **sites, *ms;
+    Heap h;
+    long hused = 0;
+    int i, n = 0;
+
+    for (h = heaps; h; h = h->next)
+	hused += h->used;
+    if (machine) {
+	printf("perm\t%ld\t%ld\t%ld\n", memlive, memblockct, maxmemlive);
+	printf("heap\t%ld\t%ld\t%ld\t%ld\n",
+	       heapct, heapbytes, hused, maxheapbytes);
+    } else {
+	printf("permanent: %ld bytes in use in %ld blocks, at most %ld\n",
+	       memlive, memblockct, maxmemlive);
+	printf("heaps: %ld heaps, %ld bytes, %ld bytes used (%ld%%), at most %ld\n",
+	       heapct, heapbytes, hused,
+	       heapbytes ? hused * 100 / heapbytes : 0L, maxheapbytes);
+    }
+    if (!memsitect || !(sites = (struct memsite **)
+			malloc(memsitect * sizeof(*sites))))
+	return;
+    for (i = 0; i < MEMSITES; i++)
+	for (ms = memsites[i]; ms; ms = ms->next)
+	    sites[n++] = ms;
+    qsort(sites, n, sizeof(*sites), memsitecmp);
+
+    if (!machine)
+	printf("\n    live  maxlive   allocs    bytes    frees    freed"
+	       "  hallocs   hbytes  site\n");
+    for (i = 0; i < n; i++) {
+	ms = sites[i];
+	if (machine)
+	    printf("site\t%s\t%d\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\n",
+		   ms->file ? ms->file : "?", ms->line, ms->live, ms->maxlive,
+		   ms->allocs, ms->bytes, ms->frees, ms->freed,
+		   ms->hallocs, ms->hbytes);
+	else
+	    printf("%8ld %8ld %8ld %8ld %8ld %8ld %8ld %8ld  %s:%d\n",
+		   ms->live, ms->maxlive, ms->allocs, ms->bytes,
+		   ms->frees, ms->freed, ms->hallocs, ms->hbytes,
+		   ms->file ? ms->file : "?", ms->line);
+    }
+    free(sites);
+}
+
+/**/
+int
+bin_mem(char *name, char **argv, char *ops, int func)
+{
+    if (ops['c'])
+	clearmemprof();
+    if (ops['e'])
+	memprof = 1;
+    if (ops['d'] && memprof) {
+	memprof = 0;
+	clearmemblocks();
+    }
+    if (ops['m'] || !(ops['c'] || ops['e'] || ops['d'])) {
+#if defined(ZSH_MEM) && defined(ZSH_MEM_DEBUG)
+	if (!ops['m'])
+	    memdump(ops);
+#endif
+	printmemprof(ops['m']);
+    }
+    return 0;
+}
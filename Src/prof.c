@@ -0,0 +1,921 @@
+/*
+ * prof.c - shell function profiling and execution tracing
+ *
+ * This file is part of zsh, the Z shell.
+ *
+ * Copyright (c) 1992-1996 Paul Falstad
+ * All rights reserved.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and to distribute modified versions of this software for any
+ * purpose, provided that the above copyright notice and the following
+ * two paragraphs appear in all copies of this software.
+ *
+ * In no event shall Paul Falstad or the Zsh Development Group be liable
+ * to any party for direct, indirect, special, incidental, or consequential
+ * damages arising out of the use of this software and its documentation,
+ * even if Paul Falstad and the Zsh Development Group have been advised of
+ * the possibility of such damage.
+ *
+ * Paul Falstad and the Zsh Development Group specifically disclaim any
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability and fitness for a particular purpose.  The software
+ * provided hereunder is on an "as is" basis, and Paul Falstad and the
+ * Zsh Development Group have no obligation to provide maintenance,
+ * support, updates, enhancements, or modifications.
+ *
+ */
+
+#include "zsh.h"
+
+/* Profiling data for a shell function.  Times are in microseconds. *
+ * Inclusive times are only accumulated by the outermost active     *
+ * call of a function, so that recursion isn't counted twice.       */
+
+typedef struct profnode *Profnode;
+typedef struct profedge *Profedge;
+
+struct profnode {
+    HashNode next;		/* next in hash chain               */
+    char *nam;			/* name of the shell function       */
+    int flags;			/* CURRENTLY UNUSED                 */
+    long calls;			/* number of completed calls        */
+    int active;			/* number of calls in progress      */
+    double wall, self;		/* inclusive and self wall time     */
+    double cpu, selfcpu;	/* inclusive and self cpu time      */
+    long loads;			/* number of times autoloaded       */
+    double loadwall;		/* wall time spent autoloading      */
+    Profedge edges;		/* functions called from this one   */
+};
+
+/* a caller -> callee arc */
+
+struct profedge {
+    Profedge next;
+    Profnode callee;
+    long calls;
+    int active;
+    double wall, cpu;
+};
+
+/* a call in progress */
+
+struct profframe {
+    Profnode node;
+    Profedge edge;		/* arc from the caller, if any      */
+    double wall, cpu;		/* times on entry                   */
+    double childwall, childcpu;	/* time spent in called functions   */
+};
+
+static HashTable proftab;
+static struct profframe *profstack;
+static int profdepth, profstacksz;
+
+/* Get the current wall clock and cpu times (shell and children). */
+
+/**/
+void
+proftime(double *wall, double *cpu)
+{
+    struct timeval tv;
+    struct timezone dummy_tz;
+#ifdef HAVE_GETRUSAGE
+    struct rusage ru;
+#else
+# ifndef WINNT
+    struct tms buf;
+# endif
+#endif
+
+    gettimeofday(&tv, &dummy_tz);
+    *wall = tv.tv_sec * 1e6 + tv.tv_usec;
+#ifdef HAVE_GETRUSAGE
+    getrusage(RUSAGE_SELF, &ru);
+    *cpu = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e6 +
+	ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+    getrusage(RUSAGE_CHILDREN, &ru);
+    *cpu += (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e6 +
+	ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+#else
+# ifndef WINNT
+    times(&buf);
+    *cpu = (double) (buf.tms_utime + buf.tms_stime +
+		     buf.tms_cutime + buf.tms_cstime) * 1e6 / sysconf(_SC_CLK_TCK);
+# else
+    *cpu = 0;
+# endif
+#endif
+}
+
+static void
+freeprofnode(HashNode hn)
+{
+    Profnode pn = (Profnode) hn;
+    Profedge e, n;
+
+    for (e = pn->edges; e; e = n) {
+	n = e->next;
+	zfree(e, sizeof(struct profedge));
+    }
+    zsfree(pn->nam);
+    zfree(pn, sizeof(struct profnode));
+}
+
+static void
+createproftable(void)
+{
+    proftab = newhashtable(17);
+
+    proftab->hash        = hasher;
+    proftab->emptytable  = NULL;
+    proftab->filltable   = NULL;
+    proftab->addnode     = addhashnode;
+    proftab->getnode     = gethashnode2;
+    proftab->getnode2    = gethashnode2;
+    proftab->removenode  = removehashnode;
+    proftab->disablenode = NULL;
+    proftab->enablenode  = NULL;
+    proftab->freenode    = freeprofnode;
+    proftab->printnode   = NULL;
+#ifdef ZSH_HASH_DEBUG
+    proftab->printinfo   = printhashtabinfo;
+    proftab->tablename   = ztrdup("proftab");
+#endif
+}
+
+static Profnode
+getprofnode(char *nam)
+{
+    Profnode pn;
+
+    if (!proftab)
+	createproftable();
+    if (!(pn = (Profnode) proftab->getnode(proftab, nam))) {
+	pn = (Profnode) zcalloc(sizeof *pn);
+	proftab->addnode(proftab, ztrdup(nam), pn);
+    }
+    return pn;
+}
+
+static Profedge
+getprofedge(Profnode caller, Profnode callee)
+{
+    Profedge e;
+
+    for (e = caller->edges; e; e = e->next)
+	if (e->callee == callee)
+	    return e;
+    e = (Profedge) zcalloc(sizeof *e);
+    e->callee = callee;
+    e->next = caller->edges;
+    caller->edges = e;
+    return e;
+}
+
+/* Called by doshfunc() or execshfunc() on entry to a function when *
+ * profiling is on.  Returns nonzero if a matching endprof() is     *
+ * needed.                                                          */
+
+/**/
+int
+startprof(char *nam)
+{
+    struct profframe *f;
+
+    if (!nam)
+	return 0;
+    if (profdepth == profstacksz) {
+	profstacksz = profstacksz ? profstacksz * 2 : 32;
+	profstack = (struct profframe *)
+	    realloc(profstack, profstacksz * sizeof(struct profframe));
+    }
+    f = profstack + profdepth;
+    f->node = getprofnode(nam);
+    f->node->active++;
+    if (profdepth) {
+	f->edge = getprofedge(f[-1].node, f->node);
+	f->edge->active++;
+    } else
+	f->edge = NULL;
+    f->childwall = f->childcpu = 0;
+    profdepth++;
+    proftime(&f->wall, &f->cpu);
+    return 1;
+}
+/* Called when the function started by startprof() returns. */
+/* Called by doshfunc() when the function returns. */
+
+/**/
+void
+endprof(void)
+{
+    struct profframe *f;
+    Profnode pn;
+    double wall, cpu;
+
+    /* the data may have been thrown away inside the function */
+    if (!profdepth)
+	return;
+    proftime(&wall, &cpu);
+    f = profstack + --profdepth;
+    wall -= f->wall;
+    cpu -= f->cpu;
+    pn = f->node;
+    pn->calls++;
+    pn->self += wall - f->childwall;
+    pn->selfcpu += cpu - f->childcpu;
+    if (!--pn->active) {
+	pn->wall += wall;
+	pn->cpu += cpu;
+    }
+    if (f->edge) {
+	f->edge->calls++;
+	if (!--f->edge->active) {
+	    f->edge->wall += wall;
+	    f->edge->cpu += cpu;
+	}
+	f[-1].childwall += wall;
+	f[-1].childcpu += cpu;
+    }
+}
+
+/* Called by getfpfunc() after autoloading a function.  The time *
+ * spent is charged to the function loaded, not to its caller.   */
+
+/**/
+void
+profload(char *nam, double wall, double cpu)
+{
+    Profnode pn;
+    double now, nowcpu;
+
+    proftime(&now, &nowcpu);
+    pn = getprofnode(nam);
+    pn->loads++;
+    pn->loadwall += now - wall;
+    if (profdepth) {
+	profstack[profdepth - 1].childwall += now - wall;
+	profstack[profdepth - 1].childcpu += nowcpu - cpu;
+    }
+}
+
+static int
+profcmp(const void *a, const void *b)
+{
+    double x = (*(Profnode *) a)->self, y = (*(Profnode *) b)->self;
+
+    return x < y ? 1 : x > y ? -1 : strcmp((*(Profnode *) a)->nam,
+					   (*(Profnode *) b)->nam);
+}
+
+/* Collect the nodes of proftab, sorted by self time. */
+
+static Profnode *
+sortprofnodes(int *np)
+{
+    Profnode *tab;
+    HashNode hn;
+    int i, n = 0;
+
+    tab = (Profnode *) halloc((proftab->ct + 1) * sizeof(Profnode));
+    for (i = 0; i < proftab->hsize; i++)
+	for (hn = proftab->nodes[i]; hn; hn = hn->next)
+	    tab[n++] = (Profnode) hn;
+    qsort(tab, n, sizeof(Profnode), profcmp);
+    *np = n;
+    return tab;
+}
+
+static void
+printprof(int machine)
+{
+    Profnode *tab, pn;
+    Profedge e;
+    double total = 0;
+    int i, n;
+
+    if (!proftab || !proftab->ct)
+	return;
+    tab = sortprofnodes(&n);
+    if (machine) {
+	for (i = 0; i < n; i++) {
+	    pn = tab[i];
+	    fputs("function\t", stdout);
+	    zputs(pn->nam, stdout);
+	    printf("\t%ld\t%.0f\t%.0f\t%.0f\t%.0f\t%ld\t%.0f\n", pn->calls,
+		   pn->wall, pn->self, pn->cpu, pn->selfcpu,
+		   pn->loads, pn->loadwall);
+	}
+	for (i = 0; i < n; i++)
+	    for (e = tab[i]->edges; e; e = e->next) {
+		fputs("call\t", stdout);
+		zputs(tab[i]->nam, stdout);
+		putchar('\t');
+		zputs(e->callee->nam, stdout);
+		printf("\t%ld\t%.0f\t%.0f\n", e->calls, e->wall, e->cpu);
+	    }
+	return;
+    }
+    for (i = 0; i < n; i++)
+	total += tab[i]->self;
+    if (total <= 0)
+	total = 1;
+    printf("%7s %11s %11s %6s %11s %11s %5s %9s  %s\n", "calls",
+	   "total ms", "self ms", "self%", "cpu ms", "self cpu", "loads",
+	   "load ms", "name");
+    for (i = 0; i < n; i++) {
+	pn = tab[i];
+	printf("%7ld %11.3f %11.3f %5.1f%% %11.3f %11.3f %5ld %9.3f  ",
+	       pn->calls, pn->wall / 1000, pn->self / 1000,
+	       100 * pn->self / total, pn->cpu / 1000, pn->selfcpu / 1000,
+	       pn->loads, pn->loadwall / 1000);
+	nicezputs(pn->nam, stdout);
+	putchar('\n');
+    }
+    for (i = 0; i < n && !tab[i]->edges; i++);
+    if (i == n)
+	return;
+    printf("\n%7s %11s %11s  %s\n", "calls", "total ms", "cpu ms",
+	   "caller -> callee");
+    for (i = 0; i < n; i++)
+	for (e = tab[i]->edges; e; e = e->next) {
+	    printf("%7ld %11.3f %11.3f  ", e->calls, e->wall / 1000,
+		   e->cpu / 1000);
+	    nicezputs(tab[i]->nam, stdout);
+	    fputs(" -> ", stdout);
+	    nicezputs(e->callee->nam, stdout);
+	    putchar('\n');
+	}
+}
+
+/* zprof: control and report shell function profiling */
+
+/**/
+int
+bin_zprof(char *name, char **argv, char *ops, int func)
+{
+    if (ops['c']) {
+	if (proftab)
+	    emptyhashtable(proftab, 17);
+	profdepth = 0;
+    }
+    if (ops['e'])
+	profiling = 1;
+    if (ops['d'])
+	profiling = 0;
+    if (ops['m'] || !(ops['c'] || ops['e'] || ops['d']))
+	printprof(ops['m']);
+    return 0;
+}
+
+/* The execution trace is a ring buffer of fixed size binary records, *
+ * so that tracing costs no allocation or formatting until the trace  *
+ * is dumped.  Process exits are seen by the SIGCHLD handler, which   *
+ * only notes them in traceexits[]; they are moved into the ring from *
+ * the main line.                                                    */
+
+#define TRACE_CMD	0	/* builtin run by the shell           */
+#define TRACE_FUNC	1	/* shell function                     */
+#define TRACE_FORK	2	/* process forked                     */
+#define TRACE_EXIT	3	/* process exited                     */
+#define TRACE_PIPE	4	/* pipeline of more than one command  */
+
+static char *tracetypes[] = { "cmd", "func", "fork", "exit", "pipe" };
+
+#define TRACETEXTSIZE JOBTEXTSIZE
+#define DEFTRACESIZE 1024
+
+struct traceent {
+    double time;		/* start, in microseconds since the epoch */
+    double dur;			/* duration in microseconds, or -1        */
+    long pid;			/* process id for fork and exit, else 0   */
+    int status;			/* exit status                            */
+    int type;			/* TRACE_* above                          */
+    char text[TRACETEXTSIZE];	/* command words (metafied, truncated)    */
+};
+
+static struct traceent *tracebuf;
+static int tracesize;
+static long tracepos;		/* number of records ever added */
+static long tracefirst;		/* first record not cleared     */
+static int tracefd = -1;	/* file descriptor for ztrace -s */
+
+/* Process exits noted by the SIGCHLD handler, waiting for traceflush() *
+ * to add them to the ring, since the handler must not change the ring  *
+ * or write to the ztrace -s descriptor itself.                         */
+
+#define TRACEEXITS 64
+
+static struct traceent traceexits[TRACEEXITS];
+static int traceexitct;
+
+/* Current wall clock time in microseconds. */
+
+/**/
+double
+tracetime(void)
+{
+    struct timeval tv;
+    struct timezone dummy_tz;
+
+    gettimeofday(&tv, &dummy_tz);
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static int
+formattrace(char *buf, struct traceent *t)
+{
+    char text[TRACETEXTSIZE];
+
+    strcpy(text, t->text);
+    unmetafy(text, NULL);
+    if (t->dur < 0)
+	return sprintf(buf, "%.6f %-4s %10s %6ld %3d  %s\n", t->time / 1e6,
+		       tracetypes[t->type], "-", t->pid, t->status, text);
+    return sprintf(buf, "%.6f %-4s %10.3f %6ld %3d  %s\n", t->time / 1e6,
+		   tracetypes[t->type], t->dur / 1000, t->pid, t->status,
+		   text);
+}
+
+#define TRACE_PENDING (-2.0)	/* duration not known yet */
+
+static void
+filltrace(struct traceent *t, int type, double start, double dur, long pid,
+	  int status, char *text)
+{
+    int len = strlen(text);
+
+    t->type = type;
+    t->time = start;
+    t->dur = dur;
+    t->pid = pid;
+    t->status = status;
+    if (len >= TRACETEXTSIZE) {
+	len = TRACETEXTSIZE - 1;
+	if (text[len - 1] == Meta)
+	    len--;
+    }
+    memcpy(t->text, text, len);
+    t->text[len] = '\0';
+}
+
+/* Add a record to the ring.  Only called from the main line, with *
+ * signals queued so that the SIGCHLD handler cannot run meanwhile. */
+
+static long
+puttrace(struct traceent *src)
+{
+    long ent = tracepos++;
+    struct traceent *t = tracebuf + ent % tracesize;
+
+    *t = *src;
+    if (tracefd >= 0 && t->dur != TRACE_PENDING) {
+	char buf[TRACETEXTSIZE + 64];
+
+	write(tracefd, buf, formattrace(buf, t));
+    }
+    return ent;
+}
+
+/* Move the exits noted by traceexit() into the ring.  If more   *
+ * processes exited than there was room for, say how many were    *
+ * lost, so that the trace does not silently miss processes.      */
+
+static void
+flushexits(void)
+{
+    int i;
+
+    for (i = 0; i < traceexitct && i < TRACEEXITS; i++)
+	puttrace(traceexits + i);
+    if (traceexitct > TRACEEXITS) {
+	struct traceent t;
+	char text[40];
+
+	sprintf(text, "(%d exits not recorded)", traceexitct - TRACEEXITS);
+	filltrace(&t, TRACE_EXIT, tracetime(), -1, 0, 0, text);
+	puttrace(&t);
+    }
+    traceexitct = 0;
+}
+
+/**/
+void
+traceflush(void)
+{
+    if (!tracebuf)
+	return;
+    queue_signals();
+    flushexits();
+    unqueue_signals();
+}
+
+static long
+addtrace(int type, double start, double dur, long pid, int status,
+	 char *text)
+{
+    struct traceent t;
+    long ent;
+
+    filltrace(&t, type, start, dur, pid, status, text);
+    queue_signals();
+    flushexits();
+    ent = puttrace(&t);
+    unqueue_signals();
+    return ent;
+}
+
+/* Start a record for a builtin (nam is NULL) or a shell function   *
+ * run in this shell.  words is the expanded argument list, starting *
+ * with the command name.  Returns a handle for traceend().          */
+
+/**/
+long
+tracestart(char *nam, LinkList words)
+{
+    char text[TRACETEXTSIZE], *p = text, *s;
+    LinkNode n;
+    int len, left = TRACETEXTSIZE - 1;
+
+    if (!words)
+	return addtrace(TRACE_FUNC, tracetime(), TRACE_PENDING, 0, 0, nam);
+    for (n = firstnode(words); n && left > 0; incnode(n)) {
+	s = (char *) getdata(n);
+	if (p != text) {
+	    *p++ = ' ';
+	    left--;
+	}
+	len = strlen(s);
+	if (len > left)
+	    len = left;
+	memcpy(p, s, len);
+	p += len;
+	left -= len;
+    }
+    *p = '\0';
+    return addtrace(nam ? TRACE_FUNC : TRACE_CMD, tracetime(), TRACE_PENDING,
+		    0, 0, text);
+}
+
+/* Start a record for a pipeline of more than one command. */
+
+/**/
+long
+tracepipe(char *text)
+{
+    return addtrace(TRACE_PIPE, tracetime(), TRACE_PENDING, 0, 0, text);
+}
+
+/* Fill in the duration and status of a record from tracestart() or *
+ * tracepipe(), unless it has been overwritten in the meantime.     */
+
+/**/
+void
+traceend(long ent, int status)
+{
+    struct traceent *t;
+
+    queue_signals();
+    flushexits();
+    if (ent >= tracefirst && tracepos - ent <= tracesize) {
+	t = tracebuf + ent % tracesize;
+	t->dur = tracetime() - t->time;
+	t->status = status;
+	if (tracefd >= 0) {
+	    char buf[TRACETEXTSIZE + 64];
+
+	    write(tracefd, buf, formattrace(buf, t));
+	}
+    }
+    unqueue_signals();
+}
+
+/**/
+void
+tracefork(Process pn)
+{
+    addtrace(TRACE_FORK, pn->bgtime.tv_sec * 1e6 + pn->bgtime.tv_usec, -1,
+	     (long) pn->pid, 0, pn->text);
+}
+
+/* Called from update_process(), in the SIGCHLD handler, once a *
+ * process has finished.  This only notes the exit; it reaches  *
+ * the ring and any ztrace -s output at the next traceflush().  */
+
+/**/
+void
+traceexit(Process pn)
+{
+    double start = pn->bgtime.tv_sec * 1e6 + pn->bgtime.tv_usec;
+    int status;
+
+    if (WIFEXITED(pn->status))
+	status = WEXITSTATUS(pn->status);
+    else if (WIFSIGNALED(pn->status))
+	status = 0200 | WTERMSIG(pn->status);
+    else
+	return;
+    if (traceexitct < TRACEEXITS)
+	filltrace(traceexits + traceexitct, TRACE_EXIT, start,
+		  pn->endtime.tv_sec * 1e6 + pn->endtime.tv_usec - start,
+		  (long) pn->pid, status, pn->text);
+    traceexitct++;
+}
+
+static void
+settracesize(int size)
+{
+    if (size != tracesize) {
+	if (tracebuf)
+	    zfree(tracebuf, tracesize * sizeof(struct traceent));
+	tracebuf = (struct traceent *) zalloc(size * sizeof(struct traceent));
+	tracesize = size;
+    }
+    tracefirst = tracepos;
+}
+
+/* ztrace: control and dump the execution trace */
+
+/**/
+int
+bin_ztrace(char *name, char **argv, char *ops, int func)
+{
+    long i, first;
+    int size = 0, fd = 2;
+
+    if (*argv) {
+	if (ops['e'])
+	    size = atoi(*argv);
+	else if (ops['s'])
+	    fd = atoi(*argv);
+	else {
+	    zwarnnam(name, "too many arguments", NULL, 0);
+	    return 1;
+	}
+	if (size < 0 || fd < 0) {
+	    zwarnnam(name, "invalid argument: %s", *argv, 0);
+	    return 1;
+	}
+    }
+    if (ops['d']) {
+	tracing = 0;
+	tracefd = -1;
+    }
+    if (ops['c']) {
+	traceflush();
+	tracefirst = tracepos;
+    }
+    if (ops['e'] || ops['s']) {
+	if (size || !tracebuf)
+	    settracesize(size ? size : DEFTRACESIZE);
+	tracefd = ops['s'] ? fd : -1;
+	tracing = 1;
+    }
+    if (ops['c'] || ops['d'] || ops['e'] || ops['s'] || !tracebuf)
+	return 0;
+    traceflush();
+    first = tracepos - tracesize > tracefirst ? tracepos - tracesize :
+	tracefirst;
+    if (ops['b']) {
+	fflush(stdout);
+	for (i = first; i < tracepos; i++)
+	    if (write(1, tracebuf + i % tracesize,
+		      sizeof(struct traceent)) != sizeof(struct traceent)) {
+		zwarnnam(name, "write error: %e", NULL, errno);
+		return 1;
+	    }
+    } else {
+	char buf[TRACETEXTSIZE + 64];
+
+	for (i = first; i < tracepos; i++) {
+	    formattrace(buf, tracebuf + i % tracesize);
+	    fputs(buf, stdout);
+	}
+    }
+    return 0;
+}
+
+/* Times in microseconds of each phase of the work done before the *
+ * last prompt, indexed by PT_*.  These are always kept, since it   *
+ * costs only a clock reading per phase, and are made available as  *
+ * the PROMPTTIMES array.                                           */
+
+static double prompttimes[PT_COUNT];
+static double promptstart;
+static int promptpending;
+
+static char *promptphases[PT_COUNT] = {
+    "scanjobs", "precmd", "periodic", "watch", "mail", "sched", "prompt",
+    "total"
+};
+
+/* Called by preprompt() before it starts.  Returns the time now. */
+
+/**/
+double
+startprompttimes(void)
+{
+    int i;
+
+    for (i = 0; i < PT_COUNT; i++)
+	prompttimes[i] = 0;
+    promptpending = 1;
+    return promptstart = tracetime();
+}
+
+/* Charge the time since start to a phase and return the time now. */
+
+/**/
+double
+prompttime(int phase, double start)
+{
+    double now = tracetime();
+
+    prompttimes[phase] += now - start;
+    return now;
+}
+
+/* Called once the prompt has been expanded, which was started at   *
+ * time start.  Only the first expansion after preprompt() counts;  *
+ * if it took more than $PROMPTWARN milliseconds altogether, say    *
+ * which phase took longest.                                        */
+
+/**/
+void
+endprompttimes(double start)
+{
+    int i, max = 0;
+    zlong warn;
+
+    if (!promptpending)
+	return;
+    promptpending = 0;
+    prompttime(PT_PROMPT, start);
+    prompttimes[PT_TOTAL] = tracetime() - promptstart;
+    startupreport();
+    if ((warn = getiparam("PROMPTWARN")) > 0 &&
+	prompttimes[PT_TOTAL] >= warn * 1000.0) {
+	for (i = 1; i < PT_TOTAL; i++)
+	    if (prompttimes[i] > prompttimes[max])
+		max = i;
+	fprintf(stderr, "zsh: prompt took %.0fms (%s %.0fms)\n",
+		prompttimes[PT_TOTAL] / 1000, promptphases[max],
+		prompttimes[max] / 1000);
+	fflush(stderr);
+    }
+}
+
+/* Function to get value of special parameter `PROMPTTIMES' */
+
+/**/
+char **
+prompttimesgetfn(Param pm)
+{
+    char **ret = (char **) halloc((PT_COUNT + 1) * sizeof(char *));
+    char buf[DIGBUFSIZE];
+    int i;
+
+    for (i = 0; i < PT_COUNT; i++) {
+	sprintf(buf, "%.0f", prompttimes[i]);
+	ret[i] = dupstring(buf);
+    }
+    ret[PT_COUNT] = NULL;
+    return ret;
+}
+
+/* Startup timing.  If ZSTARTUPTIMES is in the environment when the *
+ * shell starts, main() marks the start of each phase of its        *
+ * initialisation, and each file sourced and some of the work done  *
+ * within a phase are timed as well.  The results are printed when  *
+ * the first prompt has been expanded, to standard error or, if the *
+ * value of ZSTARTUPTIMES is a path name, appended to that file.    */
+
+struct startent {
+    char *name;			/* phase or file name         */
+    int depth;			/* 0 for a phase of main()    */
+    double start, dur;		/* microseconds, from monotime */
+};
+
+static struct startent *starttab;
+static int startct, startsz, startdepth;
+static int startphase = -1;	/* current phase of main()    */
+static double startzero;
+static char *startout;		/* $ZSTARTUPTIMES, or NULL    */
+
+/* Microseconds since some fixed point, not affected by changes *
+ * to the system clock where the system allows.                  */
+
+static double
+monotime(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_MONOTONIC, &ts))
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+#endif
+    return tracetime();
+}
+
+/* Called first thing in main() */
+
+/**/
+void
+startupinit(void)
+{
+    if ((startout = getenv("ZSTARTUPTIMES")))
+	startzero = monotime();
+}
+
+/* Start timing something; returns a handle for startupend(). */
+
+/**/
+int
+startupbegin(char *name)
+{
+    struct startent *se;
+
+    if (!startout)
+	return -1;
+    if (startct == startsz) {
+	startsz = startsz ? startsz * 2 : 32;
+	starttab = (struct startent *)
+	    zrealloc(starttab, startsz * sizeof(struct startent));
+    }
+    se = starttab + startct;
+    se->name = ztrdup(name);
+    se->depth = startdepth++;
+    se->dur = -1;
+    se->start = monotime();
+    return startct++;
+}
+
+/**/
+void
+startupend(int ent)
+{
+    if (ent < 0 || !startout)
+	return;
+    starttab[ent].dur = monotime() - starttab[ent].start;
+    startdepth--;
+}
+
+/* End the current phase of main(), if any, and start the next. */
+
+/**/
+void
+startupphase(char *name)
+{
+    if (!startout)
+	return;
+    startupend(startphase);
+    startphase = name ? startupbegin(name) : -1;
+}
+
+/* Stop recording and forget what was recorded. */
+
+/**/
+void
+startupdone(void)
+{
+    int i;
+
+    for (i = 0; i < startct; i++)
+	zsfree(starttab[i].name);
+    if (starttab)
+	zfree(starttab, startsz * sizeof(struct startent));
+    starttab = NULL;
+    startct = startsz = startdepth = 0;
+    startphase = -1;
+    startout = NULL;
+}
+
+/* Called when the first prompt has been expanded: print the times *
+ * and stop recording.                                             */
+
+/**/
+void
+startupreport(void)
+{
+    FILE *out = stderr;
+    double now;
+    int i;
+
+    if (!startout)
+	return;
+    startupphase(NULL);
+    now = monotime();
+    if (strchr(startout, '/') && !(out = fopen(startout, "a")))
+	out = stderr;
+    fprintf(out, "zsh startup %.3fms (pid %ld)\n",
+	    (now - startzero) / 1000, (long)getpid());
+    for (i = 0; i < startct; i++)
+	fprintf(out, "%10.3f  %*s%s\n", starttab[i].dur / 1000,
+		2 * starttab[i].depth, "", starttab[i].name);
+    if (out == stderr)
+	fflush(out);
+    else
+	fclose(out);
+    startupdone();
+}
@@ -44,6 +44,7 @@
 #include "mem.pro"
 #include "params.pro"
 #include "parse.pro"
+#include "prof.pro"
 #include "signals.pro"
 #include "subst.pro"
 #include "text.pro"
@@ -353,6 +353,12 @@ signal_suspend(int sig, int sig2)
 # endif
 #endif
 
+/* wait4() also tells us the resource usage of the child */
+
+#if defined(HAVE_WAIT4) && defined(HAVE_GETRUSAGE)
+# define USE_WAIT4
+#endif
+
 /* the signal handler */
  
 /**/
@@ -410,8 +416,14 @@ handler(int sig)
 	    pid_t *procsubpid = &cmdoutpid;
 	    int *procsubval = &cmdoutval;
 	    struct execstack *es = exstack;
+#ifdef USE_WAIT4
+	    struct rusage ru;
+	    struct timeinfo ti;
 
+            pid = wait4(-1, &status, WNOHANG|WUNTRACED, &ru);  /* reap the child process */
+#else
             pid = WAIT(-1, &status, WNOHANG|WUNTRACED);  /* reap the child process */
+#endif
 
             if (!pid)  /* no more children to reap */
                 break;
@@ -444,7 +456,12 @@ handler(int sig)
 
 	    /* Find the process and job containing this pid and update it. */
 	    if (findproc(pid, &jn, &pn)) {
-		update_process(pn, status);
+#ifdef USE_WAIT4
+		rusagetimes(&ru, &ti);
+		update_process(pn, status, &ti);
+#else
+		update_process(pn, status, NULL);
+#endif
 		update_job(jn);
 	    } else {
 		/* If not found, update the shell record of time spent by
@@ -702,7 +719,7 @@ dotrapargs(int sig, int *sigtr, void *sigfn)
 	    addlinknode(args, num);
 	} LASTALLOC;
 	trapreturn = -1;
-	doshfunc(sigfn, args, 0, 1);
+	doshfunc(name, sigfn, args, 0, 1);
 	freelinklist(args, (FreeFunc) NULL);
 	zsfree(name);
     } else HEAPALLOC {
@@ -43,8 +43,34 @@
  *	 assignment but not a typeset.
  * bit 1 is set on a real assignment (both typeset and normal).
  * bit 2 is a flag to paramsubst (single word sub)
+ *
+ * The two passes cannot be merged, since substitutions in later words
+ * may change what an earlier ~ or = expands to.  Instead the second
+ * pass scans each word once to find out which of its steps the word
+ * still needs at all; most words, e.g. all the words resulting from
+ * a big array or command substitution, need none of them.
  */
 
+#define WT_TOKEN	1	/* has tokens, may need ~ or = expansion */
+#define WT_NULARG	2	/* has null arguments to remove          */
+#define WT_BRACE	4	/* has a brace, may need brace expansion */
+
+static int
+wordtodo(char *s)
+{
+    int todo = 0;
+
+    for (; *s; s++)
+	if (itok(*s)) {
+	    todo |= WT_TOKEN;
+	    if (INULL(*s))
+		todo |= WT_NULARG;
+	    else if (*s == Inbrace)
+		todo |= WT_BRACE;
+	}
+    return todo;
+}
+
 /**/
 void
 prefork(LinkList list, int flags)
@@ -73,11 +99,14 @@ prefork(LinkList list, int flags)
     }
     for (node = firstnode(list); node; incnode(node)) {
 	if (*(char *)getdata(node)) {
-	    remnulargs(getdata(node));
-	    if (unset(IGNOREBRACES) && !(flags & 4))
+	    int todo = wordtodo((char *)getdata(node));
+
+	    if (todo & WT_NULARG)
+		remnulargs(getdata(node));
+	    if ((todo & WT_BRACE) && unset(IGNOREBRACES) && !(flags & 4))
 		while (hasbraces(getdata(node)))
 		    xpandbraces(list, &node);
-	    if (unset(SHFILEEXPANSION))
+	    if ((todo & WT_TOKEN) && unset(SHFILEEXPANSION))
 		filesub((char **)getaddrdata(node), flags & 3);
 	} else if (!(flags & 4))
 	    uremnode(list, node);
@@ -208,7 +237,9 @@ globlist(LinkList list)
     badcshglob = 0;
     for (node = firstnode(list); !errflag && node; node = next) {
 	next = nextnode(node);
-	glob(list, node);
+	/* words without tokens have nothing to glob or untokenize */
+	if (has_token((char *)getdata(node)))
+	    glob(list, node);
     }
     if (badcshglob == 1)
 	zerr("no match", NULL, 0);
@@ -33,6 +33,12 @@
 #define _INCLUDE_HPUX_SOURCE
 #endif
 
+/* Linux only declares splice(), tee() and memfd_create() with _GNU_SOURCE */
+#if (defined(HAVE_SPLICE) || defined(HAVE_TEE) || \
+     defined(HAVE_MEMFD_CREATE)) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE 1
+#endif
+
 /* NeXT has half-implemented POSIX support *
  * which currently fools configure         */
 #ifdef __NeXT__
@@ -172,6 +178,10 @@ struct timezone {
 # include <sys/file.h>
 #endif
 
+#ifdef HAVE_MEMFD_CREATE
+# include <sys/mman.h>
+#endif
+
 /* The following will only be defined if <sys/wait.h> is POSIX.    *
  * So we don't have to worry about union wait. But some machines   *
  * (NeXT) include <sys/wait.h> from other include files, so we     *
@@ -225,6 +235,16 @@ struct timezone {
 # include <sys/filio.h>
 #endif
 
+/* Can we be told when a file changes instead of polling it? */
+#undef USE_INOTIFY
+#if defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_INOTIFY_INIT)
+# include <sys/inotify.h>
+# define USE_INOTIFY 1
+# ifdef HAVE_SYS_VFS_H
+#  include <sys/vfs.h>
+# endif
+#endif
+
 #ifndef WINNT
 #ifdef HAVE_TERMIOS_H
 # ifdef __sco
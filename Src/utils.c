@@ -625,12 +625,16 @@ preprompt(void)
     struct schedcmd *sch, *schl;
     int period = getiparam("PERIOD");
     int mailcheck = getiparam("MAILCHECK");
+    double t = startprompttimes();
 
     in_vared = 0;
+    if (tracing)
+	traceflush();
     /* If NOTIFY is not set, then check for completed *
      * jobs before we print the prompt.               */
     if (unset(NOTIFY))
 	scanjobs();
+    t = prompttime(PT_SCANJOBS, t);
     if (errflag)
 	return;
 
@@ -642,9 +646,10 @@ preprompt(void)
 	 * to turn off the exit check.
 	 */
 	int osm = stopmsg;
-	doshfunc(list, NULL, 0, 1);
+	doshfunc("precmd", list, NULL, 0, 1);
 	stopmsg = osm;
     }
+    t = prompttime(PT_PRECMD, t);
     if (errflag)
 	return;
 
@@ -653,9 +658,10 @@ preprompt(void)
      * executed "periodic", then execute it now.                    */
     if (period && (time(NULL) > lastperiodic + period) &&
 	(list = getshfunc("periodic"))) {
-	doshfunc(list, NULL, 0, 1);
+	doshfunc("periodic", list, NULL, 0, 1);
 	lastperiodic = time(NULL);
     }
+    t = prompttime(PT_PERIODIC, t);
     if (errflag)
 	return;
 
@@ -667,6 +673,7 @@ preprompt(void)
 	    lastwatch = time(NULL);
 	}
     }
+    t = prompttime(PT_WATCH, t);
     if (errflag)
 	return;
 
@@ -675,16 +682,17 @@ preprompt(void)
 	char *mailfile;
 
 	if (mailpath && *mailpath && **mailpath)
-	    checkmailpath(mailpath);
+	    checkmail(mailpath);
 	else if ((mailfile = getsparam("MAIL")) && *mailfile) {
 	    char *x[2];
 
 	    x[0] = mailfile;
 	    x[1] = NULL;
-	    checkmailpath(x);
+	    checkmail(x);
 	}
 	lastmailcheck = time(NULL);
     }
+    t = prompttime(PT_MAIL, t);
 
     /* Check scheduled commands */
     for (schl = (struct schedcmd *)&schedcmds, sch = schedcmds; sch;
@@ -698,8 +706,261 @@ preprompt(void)
 	    sch = schl;
 	}
 	if (errflag)
+	    break;
+    }
+    prompttime(PT_SCHED, t);
+}
+
+#ifdef USE_INOTIFY
+
+/* A mailbox being watched with inotify.  Mailboxes that cannot be *
+ * watched, or that are on a network file system where changes     *
+ * made by other hosts are never reported, have wd set to -1 and   *
+ * are looked at on every check as before.                         */
+
+struct mailwatch {
+    char *path;			/* the MAILPATH element, with any ?message */
+    int wd;			/* inotify watch descriptor, or -1 */
+    int *subwds;		/* watches on the subdirectories of a directory */
+    int subct, subsz;		/* number of subwds used and allocated */
+    int isdir;			/* the mailbox is a directory */
+    int remote;			/* on a network file system: never watch */
+    int changed;		/* something happened since the last check */
+};
+
+static struct mailwatch *mailwatches;
+static int mailwatchct, mailnotify = -1;
+
+#define MAILWATCH_EVENTS (IN_MODIFY | IN_ATTRIB | IN_CREATE | \
+			  IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+			  IN_DELETE_SELF | IN_MOVE_SELF)
+
+/* Is the file system holding path one whose files can be changed *
+ * without inotify hearing of it?                                  */
+
+static int
+remotefs(char *path)
+{
+#ifdef HAVE_SYS_VFS_H
+    struct statfs sfs;
+
+    if (statfs(path, &sfs) == -1)
+	return 0;
+    switch ((unsigned long) sfs.f_type) {
+    case 0x6969:		/* NFS */
+    case 0x517b:		/* SMB */
+    case 0xff534d42:		/* CIFS */
+    case 0xfe534d42:		/* SMB2 */
+    case 0x5346414f:		/* AFS */
+    case 0x73757245:		/* CODA */
+    case 0x564c:		/* NCP */
+    case 0x65735546:		/* FUSE */
+	return 1;
+    }
+#endif
+    return 0;
+}
+
+/* The file name of the mailbox in mw, unmetafied. */
+
+static char *
+mailwatchname(struct mailwatch *mw)
+{
+    char *p, *q = NULL;
+
+    if ((p = strchr(mw->path, '?')))
+	*p = '\0';
+    else
+	q = mw->path;
+    if (!q)
+	q = dupstring(mw->path);
+    if (p)
+	*p = '?';
+    return unmeta(q);
+}
+
+/* Try to start watching the mailbox in mw. */
+
+static void
+addmailwatch(struct mailwatch *mw)
+{
+    struct stat st;
+    char *q;
+
+    if (mailnotify == -1)
+	return;
+    q = mailwatchname(mw);
+    mw->isdir = !stat(q, &st) && S_ISDIR(st.st_mode);
+    if ((mw->remote = remotefs(q)))
+	mw->wd = -1;
+    else
+	/* Reading a mailbox file matters for MAIL_WARNING, but a *
+	 * directory is read by checkmailpath() itself, and that  *
+	 * would make it look changed at every check.             */
+	mw->wd = inotify_add_watch(mailnotify, q, MAILWATCH_EVENTS |
+				   (mw->isdir ? 0 : IN_ACCESS));
+}
+
+/* checkmailpath() looks for mail all the way down a directory, but  *
+ * a watch on a directory only hears of changes to its own entries.  *
+ * Watch each subdirectory below dir as well, so that mail arriving  *
+ * in, say, the new directory of a maildir is noticed.  A directory  *
+ * already watched for mw is not entered again, which stops symbolic *
+ * link loops.                                                      */
+
+static void
+addmailsubwatches(struct mailwatch *mw, char *dir)
+{
+    struct stat st;
+    DIR *d;
+    char *fn, buf[PATH_MAX * 2];
+    int wd, i;
+
+    if (!(d = opendir(dir)))
+	return;
+    while ((fn = zreaddir(d))) {
+	/* Ignore `.' and `..'. */
+	if (fn[0] == '.' &&
+	    (fn[1] == '\0' || (fn[1] == '.' && fn[2] == '\0')))
+	    continue;
+	sprintf(buf, "%s/%s", dir, unmeta(fn));
+	if (stat(buf, &st) || !S_ISDIR(st.st_mode) ||
+	    (wd = inotify_add_watch(mailnotify, buf, MAILWATCH_EVENTS)) == -1 ||
+	    wd == mw->wd)
+	    continue;
+	for (i = 0; i < mw->subct && mw->subwds[i] != wd; i++);
+	if (i < mw->subct)
+	    continue;
+	if (mw->subct == mw->subsz) {
+	    mw->subsz = mw->subsz ? mw->subsz * 2 : 8;
+	    mw->subwds = (int *) zrealloc(mw->subwds,
+					  mw->subsz * sizeof(int));
+	}
+	mw->subwds[mw->subct++] = wd;
+	addmailsubwatches(mw, buf);
+    }
+    closedir(d);
+}
+
+/* Watch the subdirectories of the directory mailbox in mw as they *
+ * are now.  Old watches on directories that have gone away need   *
+ * no removing: the kernel drops them itself.                      */
+
+static void
+setmailsubwatches(struct mailwatch *mw)
+{
+    mw->subct = 0;
+    addmailsubwatches(mw, dupstring(mailwatchname(mw)));
+}
+
+/* Set up watches for the mailboxes in s, unless we already have. */
+
+static void
+setmailwatches(char **s)
+{
+    int i, ct = arrlen(s);
+
+    if (ct == mailwatchct) {
+	for (i = 0; i < ct; i++)
+	    if (strcmp(s[i], mailwatches[i].path))
+		break;
+	if (i == ct)
 	    return;
     }
+    for (i = 0; i < mailwatchct; i++) {
+	zsfree(mailwatches[i].path);
+	if (mailwatches[i].subwds)
+	    zfree(mailwatches[i].subwds, mailwatches[i].subsz * sizeof(int));
+    }
+    zfree(mailwatches, mailwatchct * sizeof(struct mailwatch));
+    if (mailnotify != -1)
+	zclose(mailnotify);
+    if ((mailnotify = inotify_init()) != -1) {
+	fcntl(mailnotify, F_SETFL, O_NONBLOCK);
+	mailnotify = movefd(mailnotify);
+    }
+    mailwatches = (struct mailwatch *)zalloc(ct * sizeof(struct mailwatch));
+    mailwatchct = ct;
+    for (i = 0; i < ct; i++) {
+	mailwatches[i].path = ztrdup(s[i]);
+	mailwatches[i].wd = -1;
+	mailwatches[i].subwds = NULL;
+	mailwatches[i].subct = mailwatches[i].subsz = 0;
+	mailwatches[i].isdir = 0;
+	mailwatches[i].remote = 0;
+	mailwatches[i].changed = 1;
+	addmailwatch(mailwatches + i);
+    }
+}
+
+/* Note which mailboxes inotify has told us about. */
+
+static void
+readmailwatches(void)
+{
+    char buf[1024];
+    int n, i, j;
+
+    if (mailnotify == -1)
+	return;
+    while ((n = read(mailnotify, buf, sizeof(buf))) > 0) {
+	char *p = buf;
+
+	while (p < buf + n) {
+	    struct inotify_event *ev = (struct inotify_event *)p;
+
+	    for (i = 0; i < mailwatchct; i++)
+		if (mailwatches[i].wd == ev->wd) {
+		    mailwatches[i].changed = 1;
+		    /* the mailbox itself went away: stat it from now on *
+		     * until it can be watched again                     */
+		    if (ev->mask & IN_IGNORED)
+			mailwatches[i].wd = -1;
+		} else {
+		    for (j = 0; j < mailwatches[i].subct; j++)
+			if (mailwatches[i].subwds[j] == ev->wd)
+			    mailwatches[i].changed = 1;
+		}
+	    p += sizeof(struct inotify_event) + ev->len;
+	}
+    }
+}
+
+#endif /* USE_INOTIFY */
+
+/* Check the mailboxes in s for new mail.  With inotify only those *
+ * that have been touched since the last check need to be looked   *
+ * at, so an idle prompt does no I/O on the mailboxes at all.      */
+
+/**/
+void
+checkmail(char **s)
+{
+#ifdef USE_INOTIFY
+    struct mailwatch *mw;
+    char *x[2];
+    int i;
+
+    HEAPALLOC {
+	pushheap();
+	setmailwatches(s);
+	readmailwatches();
+	x[1] = NULL;
+	for (i = 0, mw = mailwatches; i < mailwatchct && !errflag; i++, mw++)
+	    if (mw->wd == -1 || mw->changed) {
+		if (mw->wd == -1 && !mw->remote)
+		    addmailwatch(mw);
+		if (mw->wd != -1 && mw->isdir)
+		    setmailsubwatches(mw);
+		mw->changed = 0;
+		x[0] = dupstring(mw->path);
+		checkmailpath(x);
+	    }
+	popheap();
+    } LASTALLOC;
+#else
+    checkmailpath(s);
+#endif /* USE_INOTIFY */
 }
 
 /**/
@@ -1452,6 +1713,120 @@ spscan(HashNode hn, int scanflags)
     }
 }
 
+/* The names in a hash table as spckword() looks at them: sorted like *
+ * scanhashtable() does, then grouped by length.  spdist() can only    *
+ * return a usable distance if the lengths of the two strings differ   *
+ * by no more than its threshold, so just a few of the groups need to  *
+ * be looked at.  An index is rebuilt when its table has changed,      *
+ * which the gen field of the table tells us.                          */
+
+struct spindex {
+    HashTable ht;		/* the table indexed */
+    int gen;			/* ht->gen when the index was built */
+    int ct;			/* number of names */
+    int maxlen;			/* length of the longest name */
+    int *start;			/* names of length l are start[l] to start[l+1]-1 */
+    char **names;		/* the names, grouped by length */
+    int *rank;			/* position of each name in sorted order */
+};
+
+#define SPINDEXCT 8
+
+static struct spindex spindexes[SPINDEXCT];
+
+/* Get the (up to date) index for a hash table.  NULL if there is no *
+ * room for another index.                                           */
+
+static struct spindex *
+getspindex(HashTable ht)
+{
+    struct spindex *si, *fsi = NULL;
+    HashNode hn, *sorted;
+    int i, j, *lens, *pos;
+
+    for (si = spindexes; si < spindexes + SPINDEXCT; si++)
+	if (si->ht == ht)
+	    break;
+	else if (!si->ht && !fsi)
+	    fsi = si;
+    if (si == spindexes + SPINDEXCT) {
+	if (!(si = fsi))
+	    return NULL;
+	si->ht = ht;
+    } else if (si->gen == ht->gen)
+	return si;
+    else {
+	zfree(si->start, (si->maxlen + 2) * sizeof(int));
+	zfree(si->names, si->ct * sizeof(char *));
+	zfree(si->rank, si->ct * sizeof(int));
+    }
+    si->gen = ht->gen;
+    si->ct = ht->ct;
+
+    sorted = (HashNode *) zalloc(si->ct * sizeof(HashNode));
+    for (j = i = 0; i < ht->hsize; i++)
+	for (hn = ht->nodes[i]; hn; hn = hn->next)
+	    sorted[j++] = hn;
+    qsort((void *) sorted, si->ct, sizeof(HashNode), hnamcmp);
+
+    lens = (int *) zalloc(si->ct * sizeof(int));
+    for (si->maxlen = i = 0; i < si->ct; i++)
+	if ((lens[i] = strlen(sorted[i]->nam)) > si->maxlen)
+	    si->maxlen = lens[i];
+
+    /* Count the names of each length, then place them in order. */
+    si->start = (int *) zcalloc((si->maxlen + 2) * sizeof(int));
+    for (i = 0; i < si->ct; i++)
+	si->start[lens[i] + 1]++;
+    for (i = 1; i <= si->maxlen + 1; i++)
+	si->start[i] += si->start[i - 1];
+    pos = (int *) zalloc((si->maxlen + 1) * sizeof(int));
+    memcpy(pos, si->start, (si->maxlen + 1) * sizeof(int));
+    si->names = (char **) zalloc(si->ct * sizeof(char *));
+    si->rank = (int *) zalloc(si->ct * sizeof(int));
+    for (i = 0; i < si->ct; i++) {
+	j = pos[lens[i]]++;
+	si->names[j] = sorted[i]->nam;
+	si->rank[j] = i;
+    }
+    zfree(pos, (si->maxlen + 1) * sizeof(int));
+    zfree(lens, si->ct * sizeof(int));
+    zfree(sorted, si->ct * sizeof(HashNode));
+
+    return si;
+}
+
+/* Look for a better guess in a hash table.  This gives the same result *
+ * as scanning the table in sorted order with spscan(): the closest     *
+ * name wins, the last one in sorted order if there are several.        */
+
+static void
+spscantab(HashTable ht)
+{
+    struct spindex *si;
+    char *bn = NULL;
+    int gl = strlen(guess), thresh = gl / 4 + 1, l, i, nd, bd = 0, br = -1;
+
+    if (!(si = getspindex(ht))) {
+	scanhashtable(ht, 1, 0, 0, spscan, 0);
+	return;
+    }
+    for (l = (gl > thresh ? gl - thresh : 0);
+	 l <= gl + thresh && l <= si->maxlen; l++)
+	for (i = si->start[l]; i < si->start[l + 1]; i++) {
+	    nd = spdist(si->names[i], guess, thresh);
+	    if (!bn || nd < bd || (nd == bd && si->rank[i] > br)) {
+		bn = si->names[i];
+		bd = nd;
+		br = si->rank[i];
+	    }
+	}
+    if (bn && bd <= d) {
+	best = bn;
+	d = bd;
+    }
+}
+
 /* spellcheck a word */
 /* fix s ; if hist is nonzero, fix the history list too */
 
@@ -1500,7 +1875,7 @@ spckword(char **s, int hist, int cmd, int ask)
 	    return;
 	ic = String;
 	d = 100;
-	scanhashtable(paramtab, 1, 0, 0, spscan, 0);
+	spscantab(paramtab);
     } else if (**s == Equals) {
 	if (*t)
 	    return;
@@ -1508,8 +1883,8 @@ spckword(char **s, int hist, int cmd, int ask)
 	    return;
 	d = 100;
 	ic = Equals;
-	scanhashtable(aliastab, 1, 0, 0, spscan, 0);
-	scanhashtable(cmdnamtab, 1, 0, 0, spscan, 0);
+	spscantab(aliastab);
+	spscantab(cmdnamtab);
     } else {
 	guess = *s;
 	if (*guess == Tilde || *guess == String) {
@@ -1533,11 +1908,11 @@ spckword(char **s, int hist, int cmd, int ask)
 	    if (hashcmd(guess, pathchecked))
 		return;
 	    d = 100;
-	    scanhashtable(reswdtab, 1, 0, 0, spscan, 0);
-	    scanhashtable(aliastab, 1, 0, 0, spscan, 0);
-	    scanhashtable(shfunctab, 1, 0, 0, spscan, 0);
-	    scanhashtable(builtintab, 1, 0, 0, spscan, 0);
-	    scanhashtable(cmdnamtab, 1, 0, 0, spscan, 0);
+	    spscantab(reswdtab);
+	    spscantab(aliastab);
+	    spscantab(shfunctab);
+	    spscantab(builtintab);
+	    spscantab(cmdnamtab);
 	}
     }
     if (errflag)
@@ -2896,7 +3271,7 @@ spname(char *oldname)
 int
 mindist(char *dir, char *mindistguess, char *mindistbest)
 {
-    int mindistd, nd;
+    int mindistd, nd, gl, fl, thresh;
     DIR *dd;
     char *fn;
     char buf[PATH_MAX];
@@ -2911,9 +3286,13 @@ mindist(char *dir, char *mindistguess, char *mindistbest)
     }
     if (!(dd = opendir(unmeta(dir))))
 	return mindistd;
+    gl = strlen(mindistguess);
+    thresh = gl / 4 + 1;
     while ((fn = zreaddir(dd))) {
-	nd = spdist(fn, mindistguess,
-		    (int)strlen(mindistguess) / 4 + 1);
+	/* spdist() would not accept names differing more in length. */
+	if ((fl = strlen(fn)) > gl + thresh || fl < gl - thresh)
+	    continue;
+	nd = spdist(fn, mindistguess, thresh);
 	if (nd <= mindistd) {
 	    strcpy(mindistbest, fn);
 	    mindistd = nd;
@@ -3175,6 +3554,88 @@ getbaudrate(struct ttyinfo *shttyinfo)
 }
 #endif
 
+/* Scanning for the metafication routines.  Nearly all strings have no *
+ * Meta in them, and most are plain ASCII, so these look a word at a   *
+ * time for the first byte that needs attention and the callers only   *
+ * go byte by byte from there.  Words are only read from aligned       *
+ * addresses, so a read never strays onto another page past the end   *
+ * of the string.                                                      */
+
+#define WORDSZ	 sizeof(unsigned long)
+#define ONES	 ((unsigned long) -1 / 0xff)	/* 0x0101...01 */
+#define HIGHS	 (ONES * 0x80)			/* 0x8080...80 */
+
+/* non-zero if some byte of w is less than n (n <= 128) */
+#define HASLESS(W,N)	(((W) - ONES * (N)) & ~(W) & HIGHS)
+/* non-zero if some byte of w is c */
+#define HASBYTE(W,C)	HASLESS((W) ^ (ONES * (C)), 1)
+
+#define ALIGNED(P)	(!((unsigned long) (P) & (WORDSZ - 1)))
+
+/* Return the first Meta or the terminating null in s. */
+
+static char *
+findmeta(char const *s)
+{
+    unsigned long w;
+
+    for (; !ALIGNED(s); s++)
+	if (!*s || *s == Meta)
+	    return (char *) s;
+    for (;; s += WORDSZ) {
+	memcpy(&w, s, WORDSZ);
+	if (HASLESS(w, 1) | HASBYTE(w, STOUC(Meta)))
+	    break;
+    }
+    while (*s && *s != Meta)
+	s++;
+    return (char *) s;
+}
+
+/* Return the first byte in s before e that is null or has its top bit *
+ * set, which includes every byte for which imeta() is true, or e if   *
+ * there is none.  If e is NULL, s is null terminated.                 */
+
+static char *
+findhigh(char const *s, char const *e)
+{
+    unsigned long w;
+
+    for (; !ALIGNED(s) && s != e; s++)
+	if (!*s || (*s & 0x80))
+	    return (char *) s;
+    for (; !e || s + WORDSZ <= e; s += WORDSZ) {
+	memcpy(&w, s, WORDSZ);
+	if ((w & HIGHS) | HASLESS(w, 1))
+	    break;
+    }
+    for (; s != e; s++)
+	if (!*s || (*s & 0x80))
+	    break;
+    return (char *) s;
+}
+
+/* Return the first byte in s which is not printable ASCII, so that *
+ * everything before it is shown as it is by nicechar().            */
+
+static char *
+findunprint(char const *s)
+{
+    unsigned long w;
+
+    for (; !ALIGNED(s); s++)
+	if (STOUC(*s) < 0x20 || STOUC(*s) >= 0x7f)
+	    return (char *) s;
+    for (;; s += WORDSZ) {
+	memcpy(&w, s, WORDSZ);
+	if ((w & HIGHS) | HASLESS(w, 0x20) | HASBYTE(w, 0x7f))
+	    break;
+    }
+    while (STOUC(*s) >= 0x20 && STOUC(*s) < 0x7f)
+	s++;
+    return (char *) s;
+}
+
 /* Escape tokens and null characters.  Buf is the string which should be    *
  * escaped.  len is the length of the string.  If len is -1, buf should     *
  * be null terminated.  If len is non-zero and the third paramerer is not   *
@@ -3205,12 +3666,13 @@ metafy(char *buf, int len, int heap)
     static char mbuf[PATH_MAX*2+1];
 
     if (len == -1) {
-	for (e = buf, len = 0; *e; len++)
-	    if (imeta(*e++))
+	for (e = buf; *(e = findhigh(e, NULL)); e++)
+	    if (imeta(*e))
 		meta++;
+	len = e - buf;
     } else
-	for (e = buf; e < buf + len;)
-	    if (imeta(*e++))
+	for (e = buf; (e = findhigh(e, buf + len)) < buf + len; e++)
+	    if (imeta(*e))
 		meta++;
 
     if (meta || heap == META_DUP || heap == META_HEAPDUP) {
@@ -3266,7 +3728,11 @@ unmetafy(char *s, int *len)
 {
     char *p, *t;
 
-    for (p = s; *p && *p != Meta; p++);
+    if (!*(p = findmeta(s))) {
+	if (len)
+	    *len = p - s;
+	return s;
+    }
     for (t = p; (*t = *p++);)
 	if (*t++ == Meta)
 	    t[-1] = *p++ ^ 32;
@@ -3305,13 +3771,17 @@ unmeta(char *file_name)
     static char fn[PATH_MAX];
     char *p, *t;
 
-    for (t = file_name, p = fn; *t && p < fn + PATH_MAX - 1; p++)
+    /* without Meta the name can be used as it is */
+    if (!*(t = findmeta(file_name)))
+	return t - file_name < PATH_MAX ? file_name : NULL;
+    if (t - file_name >= PATH_MAX)
+	return NULL;
+    memcpy(fn, file_name, t - file_name);
+    for (p = fn + (t - file_name); *t && p < fn + PATH_MAX - 1; p++)
 	if ((*p = *t++) == Meta)
 	    *p = *t++ ^ 32;
     if (*t)
 	return NULL;
-    if (p - fn == t - file_name)
-	return file_name;
     *p = '\0';
     return fn;
 }
@@ -3324,12 +3794,26 @@ int
 ztrcmp(unsigned char const *s1, unsigned char const *s2)
 {
     int c1, c2;
-
+    unsigned long w1, w2;
+
+    /* compare a word at a time while both are aligned alike */
+    if (!(((unsigned long) s1 ^ (unsigned long) s2) & (WORDSZ - 1))) {
+	for (; !ALIGNED(s1); s1++, s2++)
+	    if (!*s1 || *s1 != *s2)
+		goto differ;
+	for (;; s1 += WORDSZ, s2 += WORDSZ) {
+	    memcpy(&w1, s1, WORDSZ);
+	    memcpy(&w2, s2, WORDSZ);
+	    if (w1 != w2 || HASLESS(w1, 1))
+		break;
+	}
+    }
     while(*s1 && *s1 == *s2) {
 	s1++;
 	s2++;
     }
 
+  differ:
     if(!(c1 = *s1))
 	c1 = -1;
     else if(c1 == STOUC(Meta))
@@ -3383,18 +3867,19 @@ metadiffer(char const *s, char const *r, int len)
 int
 ztrlen(char const *s)
 {
+    char const *t;
     int l;
 
-    for (l = 0; *s; l++)
-	if (*s++ == Meta) {
+    for (l = 0; *(t = findmeta(s)); s = t + 2) {
+	l += t - s + 1;
 #ifdef DEBUG
-	    if (! *s)
-		fprintf(stderr, "BUG: unexpected end of string in ztrlen()\n");
-	    else
-#endif
-	    s++;
+	if (!t[1]) {
+	    fprintf(stderr, "BUG: unexpected end of string in ztrlen()\n");
+	    return l;
 	}
-    return l;
+#endif
+    }
+    return l + (t - s);
 }
 
 /* Subtract two pointers in a metafied string. */
@@ -3427,6 +3912,58 @@ zreaddir(DIR *dir)
     return de ? metafy(de->d_name, -1, META_STATIC) : NULL;
 }
 
+/* Like zreaddir(), but also return in *typ the file type bits (as in *
+ * st_mode) of the entry, if the system hands them out with the name. *
+ * This is the type of the entry itself, so a symbolic link gives     *
+ * S_IFLNK.  *typ is 0 if the type is not known.                      */
+
+/**/
+char *
+zreaddirtype(DIR *dir, int *typ)
+{
+    struct dirent *de = readdir(dir);
+
+    *typ = 0;
+    if (!de)
+	return NULL;
+#ifdef HAVE_DIRENT_D_TYPE
+    switch (de->d_type) {
+    case DT_DIR:
+	*typ = S_IFDIR;
+	break;
+    case DT_REG:
+	*typ = S_IFREG;
+	break;
+# if defined(DT_LNK) && defined(S_IFLNK)
+    case DT_LNK:
+	*typ = S_IFLNK;
+	break;
+# endif
+# if defined(DT_FIFO) && defined(S_IFIFO)
+    case DT_FIFO:
+	*typ = S_IFIFO;
+	break;
+# endif
+# ifdef DT_CHR
+    case DT_CHR:
+	*typ = S_IFCHR;
+	break;
+# endif
+# ifdef DT_BLK
+    case DT_BLK:
+	*typ = S_IFBLK;
+	break;
+# endif
+# if defined(DT_SOCK) && defined(S_IFSOCK)
+    case DT_SOCK:
+	*typ = S_IFSOCK;
+	break;
+# endif
+    }
+#endif
+    return metafy(de->d_name, -1, META_STATIC);
+}
+
 /* Unmetafy and output a string. */
 
 /**/
@@ -3453,9 +3990,18 @@ zputs(char const *s, FILE *stream)
 int
 nicezputs(char const *s, FILE *stream)
 {
+    char const *t;
     int c;
 
-    while ((c = *s++)) {
+    for (;;) {
+	/* printable ASCII is written out as it is */
+	if ((t = findunprint(s)) != s) {
+	    if (fwrite(s, 1, t - s, stream) != t - s)
+		return EOF;
+	    s = t;
+	}
+	if (!(c = *s++))
+	    break;
 	if (itok(c)) {
 	    if (c <= Comma)
 		c = ztokens[c - Pound];
@@ -3476,10 +4022,15 @@ nicezputs(char const *s, FILE *stream)
 size_t
 niceztrlen(char const *s)
 {
+    char const *t;
     size_t l = 0;
     int c;
 
-    while ((c = *s++)) {
+    for (;;) {
+	l += (t = findunprint(s)) - s;
+	s = t;
+	if (!(c = *s++))
+	    break;
 	if (itok(c)) {
 	    if (c <= Comma)
 		c = ztokens[c - Pound];
@@ -338,53 +338,135 @@ ucmp(STRUCT_UTMP *u, STRUCT_UTMP *v)
     return u->ut_time - v->ut_time;
 }
 
-/* initialize the user List */
+#ifdef USER_PROCESS
+# define watchuser(U) ((U)->ut_type == USER_PROCESS)
+#else
+# define watchuser(U) ((U)->ut_name[0])
+#endif
 
-/**/
-void
-readwtab(void)
+/* Read the whole of the utmp file into *tabp, in file order, *
+ * and return the number of records.                          */
+
+static int
+readutmp(STRUCT_UTMP **tabp)
 {
-    STRUCT_UTMP *uptr;
-    int wtabmax = 32;
+    STRUCT_UTMP *tab;
+    int tabsz = 0, tabmax = wtabsz + 4;
     FILE *in;
 
-    wtabsz = 0;
-    if (!(in = fopen(UTMP_FILE, "r")))
+    if (!(in = fopen(UTMP_FILE, "r"))) {
+	*tabp = (STRUCT_UTMP *)zalloc(sizeof(STRUCT_UTMP));
+	return 0;
+    }
+    tab = (STRUCT_UTMP *)zalloc(tabmax * sizeof(STRUCT_UTMP));
+    while (fread(tab + tabsz, sizeof(STRUCT_UTMP), 1, in))
+	if (++tabsz == tabmax)
+	    tab = (STRUCT_UTMP *)realloc((void *) tab, (tabmax *= 2) *
+					 sizeof(STRUCT_UTMP));
+    fclose(in);
+    *tabp = tab;
+    return tabsz;
+}
+
+#ifdef USE_INOTIFY
+/* inotify descriptor watching the utmp file, or -1 */
+
+static int utmpnotify = -1;
+
+/* Ask to be told when the utmp file changes.  If that cannot be *
+ * done, the file is polled every LOGCHECK seconds instead.      */
+
+static void
+notifyutmp(void)
+{
+    int fd;
+
+    if (utmpnotify != -1 || (fd = inotify_init()) == -1)
 	return;
-    uptr = wtab = (STRUCT_UTMP *)zalloc(wtabmax * sizeof(STRUCT_UTMP));
-    while (fread(uptr, sizeof(STRUCT_UTMP), 1, in))
-#ifdef USER_PROCESS
-	if   (uptr->ut_type == USER_PROCESS)
-#else
-	if   (uptr->ut_name[0])
-#endif
-	{
-	    uptr++;
-	    if (++wtabsz == wtabmax)
-		uptr = (wtab = (STRUCT_UTMP *)realloc((void *) wtab, (wtabmax *= 2) *
-						      sizeof(STRUCT_UTMP))) + wtabsz;
+    if (inotify_add_watch(fd, UTMP_FILE, IN_MODIFY | IN_ATTRIB |
+			  IN_DELETE_SELF | IN_MOVE_SELF) == -1) {
+	close(fd);
+	return;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    utmpnotify = movefd(fd);
+}
+#endif /* USE_INOTIFY */
+
+/* Check whether the utmp file may have changed since we last read it. */
+
+static int
+utmpchanged(void)
+{
+    struct stat st;
+
+#ifdef USE_INOTIFY
+    if (utmpnotify != -1 && lastutmpcheck) {
+	char buf[512];
+	int changed = 0, gone = 0, n;
+
+	while ((n = read(utmpnotify, buf, sizeof(buf))) > 0) {
+	    char *p = buf;
+
+	    changed = 1;
+	    while (p < buf + n) {
+		struct inotify_event *ev = (struct inotify_event *)p;
+
+		if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+		    gone = 1;
+		p += sizeof(struct inotify_event) + ev->len;
+	    }
 	}
-    fclose(in);
+	if (gone) {
+	    /* the file was replaced: watch the new one, or go back *
+	     * to polling if there is none.                         */
+	    zclose(utmpnotify);
+	    utmpnotify = -1;
+	    notifyutmp();
+	}
+	if (changed)
+	    lastutmpcheck = time(NULL);
+	if (utmpnotify != -1)
+	    return changed;
+    }
+#endif /* USE_INOTIFY */
+    if ((stat(UTMP_FILE, &st) == -1) || (st.st_mtime <= lastutmpcheck))
+	return 0;
+    lastutmpcheck = st.st_mtime;
+    return 1;
+}
+
+/* compare 2 pointers to utmp entries */
 
-    if (wtabsz)
-	qsort((void *) wtab, wtabsz, sizeof(STRUCT_UTMP),
-	           (int (*) _((const void *, const void *)))ucmp);
+static int
+upcmp(STRUCT_UTMP **u, STRUCT_UTMP **v)
+{
+    return ucmp(*u, *v);
+}
+
+/* initialize the user List */
+
+/**/
+void
+readwtab(void)
+{
+    wtabsz = readutmp(&wtab);
 }
 
 /* Check for login/logout events; executed before *
- * each prompt if WATCH is set                    */
+ * each prompt if WATCH is set.                   *
+ * wtab holds the utmp file as it was last read,  *
+ * slot by slot; only the slots that are now      *
+ * different are looked at.                       */
 
 /**/
 void
 dowatch(void)
 {
-    FILE *in;
-    STRUCT_UTMP *utab, *uptr, *wptr;
-    struct stat st;
+    STRUCT_UTMP *utab, **outs, **ins;
     char **s;
     char *fmt;
-    int utabsz = 0, utabmax = wtabsz + 4;
-    int uct, wct;
+    int utabsz, max, i, outct = 0, inct = 0, o, n;
 
     s = watch;
     if (!(fmt = getsparam("WATCHFMT")))
@@ -393,58 +475,51 @@ dowatch(void)
     holdintr();
     if (!wtab) {
 	readwtab();
+#ifdef USE_INOTIFY
+	notifyutmp();
+#endif
 	noholdintr();
 	return;
     }
-    if ((stat(UTMP_FILE, &st) == -1) || (st.st_mtime <= lastutmpcheck)) {
-	noholdintr();
-	return;
-    }
-    lastutmpcheck = st.st_mtime;
-    uptr = utab = (STRUCT_UTMP *) zalloc(utabmax * sizeof(STRUCT_UTMP));
-
-    if (!(in = fopen(UTMP_FILE, "r"))) {
-	free(utab);
+    if (!utmpchanged()) {
 	noholdintr();
 	return;
     }
-    while (fread(uptr, sizeof *uptr, 1, in))
-#ifdef USER_PROCESS
-	if (uptr->ut_type == USER_PROCESS)
-#else
-	if (uptr->ut_name[0])
-#endif
-	{
-	    uptr++;
-	    if (++utabsz == utabmax)
-		uptr = (utab = (STRUCT_UTMP *)realloc((void *) utab, (utabmax *= 2) *
-						      sizeof(STRUCT_UTMP))) + utabsz;
-	}
-    fclose(in);
+    utabsz = readutmp(&utab);
     noholdintr();
     if (errflag) {
 	free(utab);
 	return;
     }
-    if (utabsz)
-	qsort((void *) utab, utabsz, sizeof(STRUCT_UTMP),
-	           (int (*) _((const void *, const void *)))ucmp);
-
-    wct = wtabsz;
-    uct = utabsz;
-    uptr = utab;
-    wptr = wtab;
-    if (errflag) {
-	free(utab);
-	return;
+
+    max = (utabsz > wtabsz) ? utabsz : wtabsz;
+    outs = (STRUCT_UTMP **)zalloc((max + 1) * sizeof(STRUCT_UTMP *));
+    ins = (STRUCT_UTMP **)zalloc((max + 1) * sizeof(STRUCT_UTMP *));
+    for (i = 0; i < max; i++) {
+	o = i < wtabsz && watchuser(wtab + i);
+	n = i < utabsz && watchuser(utab + i);
+	if (o && n && !ucmp(wtab + i, utab + i))
+	    continue;
+	if (o)
+	    outs[outct++] = wtab + i;
+	if (n)
+	    ins[inct++] = utab + i;
     }
-    while ((uct || wct) && !errflag)
-	if (!uct || (wct && ucmp(uptr, wptr) > 0))
-	    wct--, watchlog(0, wptr++, s, fmt);
-	else if (!wct || (uct && ucmp(uptr, wptr) < 0))
-	    uct--, watchlog(1, uptr++, s, fmt);
+
+    /* report them in time order, as they happened */
+    if (outct > 1)
+	qsort((void *) outs, outct, sizeof(STRUCT_UTMP *),
+	           (int (*) _((const void *, const void *)))upcmp);
+    if (inct > 1)
+	qsort((void *) ins, inct, sizeof(STRUCT_UTMP *),
+	           (int (*) _((const void *, const void *)))upcmp);
+    for (o = n = 0; (o < outct || n < inct) && !errflag;)
+	if (n == inct || (o < outct && ucmp(ins[n], outs[o]) > 0))
+	    watchlog(0, outs[o++], s, fmt);
 	else
-	    uptr++, wptr++, wct--, uct--;
+	    watchlog(1, ins[n++], s, fmt);
+    free(outs);
+    free(ins);
     free(wtab);
     wtab = utab;
     wtabsz = utabsz;
@@ -133,6 +133,17 @@ ZLEXTERN int zleactive INIT_ZERO;
 /* the line buffer */
 ZLEXTERN unsigned char *line INIT_ZERO;
 
+/* While only commands flagged ZLE_SIMPLE are run, the line buffer *
+ * may have a gap of gaplen unused chars at gapcs, so that typing  *
+ * in front of a long tail does not move the whole tail each time. *
+ * Such commands read the line only through zlechar() and change   *
+ * it only through spaceinline() and shiftchars(); before any      *
+ * other command the gap is closed with closegap().                */
+ZLEXTERN int gapcs INIT_ZERO, gaplen INIT_ZERO;
+
+/* the char at position x of the line, allowing for the gap */
+#define zlechar(X) (line[(X) < gapcs ? (X) : (X) + gaplen])
+
 /* left prompt and right prompt */
 ZLEXTERN char *lpmpt INIT_ZERO, *rpmpt INIT_ZERO;
 
@@ -212,22 +223,37 @@ struct zlecmd {
 
 /* undo event */
 
+/* One change to the line.  The change replaced del chars at pref by *
+ * ins chars; text holds the removed chars followed by the inserted   *
+ * ones, so the change can be both undone and redone.                 */
+
 struct undoent {
+    struct undoent *prev, *next;
     int pref;			/* number of initial chars unchanged */
-    int suff;			/* number of trailing chars unchanged */
-    int len;			/* length of changed chars */
+    int del;			/* number of chars removed */
+    int ins;			/* number of chars inserted */
     int cs;			/* cursor pos before change */
-    char *change;		/* NOT null terminated */
+    int ncs;			/* cursor pos after change */
+    int flags;			/* UNDO_* flags below */
+    int size;			/* allocated size of text */
+    char *text;			/* NOT null terminated */
 };
 
-#define UNDOCT 64
+#define UNDO_SELFINSERT	(1<<0)	/* typed text, may be extended */
+#define UNDO_VIUNDONE	(1<<1)	/* undone by vi-undo-change */
 
-ZLEXTERN struct undoent undos[UNDOCT] INIT_ZERO_STRUCT_ARRAY;
+/* Total size of the undo records kept for a line; the oldest ones *
+ * are dropped beyond this.                                         */
+
+#define UNDOMEM 262144
+
+/* the list of changes, and the last change not undone */
+ZLEXTERN struct undoent *undolist INIT_ZERO, *curundo INIT_ZERO;
 
 /* the line before last mod (for undo purposes) */
 ZLEXTERN unsigned char *lastline INIT_ZERO;
 
-ZLEXTERN int undoct INIT_ZERO, lastcs INIT_ZERO, lastll INIT_ZERO;
+ZLEXTERN int lastcs INIT_ZERO, lastll INIT_ZERO;
 
 ZLEXTERN char *visrchstr INIT_ZERO;
 ZLEXTERN int visrchsense INIT_ZERO;
@@ -244,9 +270,25 @@ ZLEXTERN int visrchsense INIT_ZERO;
 #define ZLE_INSERT	(1<<9)
 #define ZLE_DELETE	(1<<10)
 #define ZLE_DIGIT	(1<<11)
+#define ZLE_SIMPLE	(1<<12)
 
 typedef struct key *Key;
 
+/* The type of a file found while completing, so that it need not be *
+ * looked up again when the match is inserted or listed.  The modes  *
+ * are 0 if not known; for anything but a plain file only the type   *
+ * bits are guaranteed to be there.                                  */
+
+struct ftype {
+    struct hashnode *next;
+    char *nam;			/* hash data: the path as seen by ztat() */
+    int flags;			/* CURRENTLY UNUSED */
+    int lmode;			/* mode as returned by lstat() */
+    int smode;			/* mode as returned by stat() */
+};
+
+typedef struct ftype *Ftype;
+
 ZLEXTERN int *bindtab INIT_ZERO, *mainbindtab INIT_ZERO;
 extern int emacsbind[] , viinsbind[] , vicmdbind[] ;
 ZLEXTERN int altbindtab[256] INIT_ZERO_STRUCT;
@@ -298,6 +340,7 @@ enum {
     z_beginningofhistory,
     z_beginningofline,
     z_beginningoflinehist,
+    z_bracketedpaste,
     z_capitalizeword,
     z_clearscreen,
     z_completeword,
@@ -359,6 +402,7 @@ enum {
     z_quoteline,
     z_quoteregion,
     z_redisplay,
+    z_redo,
     z_reversemenucomplete,
     z_runhelp,
     z_selfinsert,
@@ -37,8 +37,8 @@ struct zlecmd zlecmds[] =
     {"accept-and-menu-complete", acceptandmenucomplete, ZLE_MENUCMP},
     {"accept-line", acceptline, 0},
     {"accept-line-and-down-history", acceptlineanddownhistory, 0},
-    {"backward-char", backwardchar, ZLE_MOVEMENT},
-    {"backward-delete-char", backwarddeletechar, ZLE_DELETE},
+    {"backward-char", backwardchar, ZLE_MOVEMENT | ZLE_SIMPLE},
+    {"backward-delete-char", backwarddeletechar, ZLE_DELETE | ZLE_SIMPLE},
     {"backward-delete-word", backwarddeleteword, ZLE_DELETE},
     {"backward-kill-line", backwardkillline, ZLE_KILL},
     {"backward-kill-word", backwardkillword, ZLE_KILL | ZLE_DELETE},
@@ -47,12 +47,13 @@ struct zlecmd zlecmds[] =
     {"beginning-of-history", beginningofhistory, 0},
     {"beginning-of-line", beginningofline, ZLE_MOVEMENT},
     {"beginning-of-line-hist", beginningoflinehist, ZLE_MOVEMENT},
+    {"bracketed-paste", bracketedpaste, 0},
     {"capitalize-word", capitalizeword, 0},
     {"clear-screen", clearscreen, ZLE_MENUCMP},
     {"complete-word", completeword, ZLE_MENUCMP},
     {"copy-prev-word", copyprevword, 0},
     {"copy-region-as-kill", copyregionaskill, ZLE_KILL},
-    {"delete-char", deletechar, ZLE_DELETE},
+    {"delete-char", deletechar, ZLE_DELETE | ZLE_SIMPLE},
     {"delete-char-or-list", deletecharorlist, ZLE_MENUCMP},
     {"delete-word", deleteword, ZLE_DELETE},
     {"describe-key-briefly", describekeybriefly, ZLE_MENUCMP},
@@ -75,7 +76,7 @@ struct zlecmd zlecmds[] =
     {"expand-or-complete", expandorcomplete, ZLE_MENUCMP},
     {"expand-or-complete-prefix", expandorcompleteprefix, ZLE_MENUCMP},
     {"expand-word", expandword, 0},
-    {"forward-char", forwardchar, ZLE_MOVEMENT},
+    {"forward-char", forwardchar, ZLE_MOVEMENT | ZLE_SIMPLE},
     {"forward-word", forwardword, ZLE_MOVEMENT},
     {"get-line", getline, 0},
     {"gosmacs-transpose-chars", gosmacstransposechars, 0},
@@ -108,10 +109,11 @@ struct zlecmd zlecmds[] =
     {"quote-line", quoteline, 0},
     {"quote-region", quoteregion, 0},
     {"redisplay", redisplay, ZLE_MENUCMP},
+    {"redo", redo, ZLE_UNDO},
     {"reverse-menu-complete", reversemenucomplete, ZLE_MENUCMP},
     {"run-help", processcmd, ZLE_MENUCMP},
-    {"self-insert", selfinsert, ZLE_INSERT},
-    {"self-insert-unmeta", selfinsertunmeta, ZLE_INSERT},
+    {"self-insert", selfinsert, ZLE_INSERT | ZLE_SIMPLE},
+    {"self-insert-unmeta", selfinsertunmeta, ZLE_INSERT | ZLE_SIMPLE},
     {"send-break", sendbreak, 0},
     {"send-string", sendstring, 0},
     {"set-mark-command", setmarkcommand, ZLE_MENUCMP},
@@ -184,7 +186,7 @@ struct zlecmd zlecmds[] =
     {"vi-set-mark", visetmark, ZLE_MENUCMP},
     {"vi-substitute", visubstitute, 0},
     {"vi-swap-case", viswapcase, 0},
-    {"vi-undo-change", undo, 0},
+    {"vi-undo-change", viundochange, 0},
     {"vi-unindent", viunindent, 0},
     {"vi-up-line-or-history", viuplineorhistory, ZLE_LINEMOVE | ZLE_MOVEMENT},
     {"vi-yank", viyank, 0},
@@ -389,6 +389,58 @@ getkey(int keytmout)
     return ret;
 }
 
+/* Read the text of a bracketed paste, up to the ESC [ 2 0 1 ~ that    *
+ * ends it.  Whatever the terminal has sent is taken a buffer at a time *
+ * rather than key by key; anything following the end of the paste is  *
+ * pushed back as typeahead.  Newlines come back as \n whether the      *
+ * terminal sent \r or \n.  The returned buffer is not NUL-terminated.  */
+
+/**/
+char *
+getpaste(int *lenp)
+{
+    static char endpaste[] = "\33[201~";
+    int sz = 256, len = 0, done = 0, old_errno = errno, r, i;
+    char *buf = (char *)zalloc(sz);
+
+    for (;;) {
+	for (i = done; i + 6 <= len; i++)
+	    if (!memcmp(buf + i, endpaste, 6))
+		break;
+	if (i + 6 <= len)
+	    break;
+	done = i;
+	if (sz - len < 128)
+	    buf = realloc(buf, sz *= 2);
+	if (kungetct) {
+	    while (kungetct && len < sz)
+		buf[len++] = kungetbuf[--kungetct];
+	    continue;
+	}
+	if ((r = read(SHTTY, buf + len, sz - len)) <= 0) {
+	    if (r < 0 && errno == EINTR && !errflag)
+		continue;
+	    /* give up and keep what we have got */
+	    i = len;
+	    break;
+	}
+	/* same exchange of \n and \r as in getkey() */
+	for (; r--; len++)
+	    if (buf[len] == '\r')
+		buf[len] = '\n';
+	    else if (buf[len] == '\n')
+		buf[len] = '\r';
+    }
+    if (i + 6 <= len)
+	ungetkeys(buf + i + 6, len - i - 6);
+    for (len = 0; len < i; len++)
+	if (buf[len] == '\r')
+	    buf[len] = '\n';
+    *lenp = len;
+    errno = old_errno;
+    return buf;
+}
+
 /* Where to print out bindings:  either stdout, or the zle output shout */
 static FILE *bindout;
 
@@ -396,6 +448,10 @@ static FILE *bindout;
 
 static int no_restore_tty;
 
+/* Set if we have put the terminal into bracketed paste mode. */
+
+static int pastemode;
+
 /**/
 unsigned char *
 zleread(char *lp, char *rp)
@@ -443,6 +499,7 @@ zleread(char *lp, char *rp)
 	undoing = 1;
 	line = (unsigned char *)zalloc((linesz = 256) + 2);
 	virangeflag = vilinerange = lastcmd = done = cs = ll = mark = 0;
+	gaplen = 0;
 	curhistline = NULL;
 	zmult = 1;
 	vibufspec = 0;
@@ -480,6 +537,13 @@ zleread(char *lp, char *rp)
 	 * to every call to zleread().
 	 */
 	no_restore_tty = (histdone & HISTFLAG_SETTY);
+#ifndef WINNT
+	if (isset(BRACKETEDPASTE) &&
+	    !(termflags & (TERM_BAD | TERM_UNKNOWN))) {
+	    fputs("\33[?2004h", shout);
+	    pastemode = 1;
+	}
+#endif /* WINNT */
 	resetneeded = 1;
 	refresh();
 	errflag = retflag = 0;
@@ -503,13 +567,14 @@ zleread(char *lp, char *rp)
 		}
 		if ((lastcmd & ZLE_UNDO) != (zc->flags & ZLE_UNDO) && undoing)
 		    addundo();
+		startedit(zc->flags);
 		if (bindk != z_sendstring) {
 		    if (!(zc->flags & ZLE_MENUCMP))
 			invalidatelist();
 		    if (!(zc->flags & ZLE_MENUCMP) &&
 			addedsuffix && !(zc->flags & ZLE_DELETE) &&
 			!((zc->flags & ZLE_INSERT) && c != ' ' &&
-			  (c != '/' || addedsuffix > 1 || line[cs-1] != c))) {
+			  (c != '/' || addedsuffix > 1 || zlechar(cs-1) != c))) {
 			backdel(addedsuffix);
 		    }
 		    if (!menucmp && !((zc->flags & ZLE_INSERT) && /*{*/
@@ -520,7 +585,7 @@ zleread(char *lp, char *rp)
 		    (*zc->func) ();
 		/* for vi mode, make sure the cursor isn't somewhere illegal */
 		if (bindtab == altbindtab && cs > findbol() &&
-		    (cs == ll || line[cs] == '\n'))
+		    (cs == ll || zlechar(cs) == '\n'))
 		    cs--;
 		if (ce == complexpect && ce && !menucmp)
 		    complexpect = 0;
@@ -546,14 +611,19 @@ zleread(char *lp, char *rp)
 		if (!kungetct)
 		    refresh();
 	}
+	closegap();
 	statusline = NULL;
 	invalidatelist();
+	if (pastemode) {
+	    fputs("\33[?2004l", shout);
+	    pastemode = 0;
+	}
 	trashzle();
 	zleactive = no_restore_tty = 0;
 	alarm(0);
     } LASTALLOC;
     zsfree(curhistline);
-    free(lastline);		/* freeundo */
+    freeundo();
     if (eofsent) {
 	free(line);
 	line = NULL;
@@ -691,6 +761,27 @@ makefunckey(int fun)
     return ky;
 }
 
+/* Bind ESC [ 2 0 0 ~, which a terminal in bracketed paste mode sends *
+ * in front of pasted text, in the multi-character table tab.          */
+
+static void
+bindpastekey(HashTable tab)
+{
+    static char seq[] = "\33\133200~";
+    char buf[sizeof(seq)];
+    Key ky;
+    int i;
+
+    for (i = 1; i < 6; i++) {
+	memcpy(buf, seq, i);
+	buf[i] = '\0';
+	if (!(ky = (Key) tab->getnode(tab, buf)))
+	    tab->addnode(tab, ztrdup(buf), ky = makefunckey(z_undefinedkey));
+	ky->prefixct++;
+    }
+    tab->addnode(tab, ztrdup(seq), makefunckey(z_bracketedpaste));
+}
+
 /* initialize the key bindings */
 
 /**/
@@ -784,6 +875,8 @@ initkeybindings(void)
 	    emkeybindtab->addnode(emkeybindtab, ztrdup(buf), makefunckey(emacsbind[i]));
 	    ky->prefixct++;
 	}
+    bindpastekey(emkeybindtab);
+    bindpastekey(vikeybindtab);
     stackhist = stackcs = -1;
 }
 
@@ -37,6 +37,7 @@ selfinsert(void)
     int ncs = cs + zmult;
 
     if (complexpect && isset(AUTOPARAMKEYS)) {
+	slowedit();
 	if (complexpect == 2 && /*{*/ c == '}') {
 	    if (!menucmp || line[cs-1] == '/' || addedsuffix) {
 		int i = 0;
@@ -66,8 +67,12 @@ selfinsert(void)
     }
     if (insmode || ll == cs)
 	spaceinline(zmult);
-    else if (zmult + cs > ll)
-	spaceinline(ll - (zmult + cs));
+    else {
+	/* overwriting is done in place */
+	slowedit();
+	if (zmult + cs > ll)
+	    spaceinline(zmult + cs - ll);
+    }
     while (zmult--)
 	line[cs++] = c;
     cs = ncs;
@@ -364,6 +369,26 @@ yankpop(void)
     kct = (kct + KRINGCT - 1) % KRINGCT;
 }
 
+/* Insert text pasted while the terminal is in bracketed paste mode. *
+ * The whole block goes in with one spaceinline(), so that it is a   *
+ * single change for undo and is shown by a single refresh.          */
+
+/**/
+void
+bracketedpaste(void)
+{
+    int len;
+    char *buf = getpaste(&len);
+
+    if (len) {
+	mark = cs;
+	spaceinline(len);
+	memcpy((char *)line + cs, buf, len);
+	cs += len;
+    }
+    free(buf);
+}
+
 /**/
 void
 overwritemode(void)
@@ -465,24 +490,32 @@ sendbreak(void)
 void
 undo(void)
 {
-    char *s;
-    struct undoent *ue;
+    struct undoent *ue = curundo;
+
+    if (!ue) {
+	feep();
+	return;
+    }
+    undochange(ue->pref, ue->ins, ue->text, ue->del);
+    ue->flags &= ~UNDO_SELFINSERT;
+    lastcs = cs = ue->cs;
+    curundo = ue->prev;
+}
+
+/**/
+void
+redo(void)
+{
+    struct undoent *ue = curundo ? curundo->next : undolist;
 
-    ue = undos + undoct;
-    if (!ue->change) {
+    if (!ue) {
 	feep();
 	return;
     }
-    line[ll] = '\0';
-    s = zalloc(ue->suff + 1);
-    memcpy(s, (char *)&line[ll - ue->suff], ue->suff);
-    sizeline(ll = ue->pref + ue->suff + ue->len);
-    memcpy((char *)line + ue->pref, ue->change, ue->len);
-    memcpy((char *)line + ue->pref + ue->len, s, ue->suff);
-    zfree(s, ue->suff + 1);
-    ue->change = NULL;
-    undoct = (undoct + UNDOCT - 1) % UNDOCT;
-    cs = ue->cs;
+    undochange(ue->pref, ue->del, ue->text + ue->del, ue->ins);
+    ue->flags &= ~(UNDO_SELFINSERT | UNDO_VIUNDONE);
+    lastcs = cs = ue->ncs;
+    curundo = ue;
 }
 
 /**/
@@ -782,7 +815,7 @@ tsetcap(int cap, int flag)
 	    tputs(tcstr[cap], 1, putraw);
 	    break;
 	case 0:
-	    tputs(tcstr[cap], 1, putshout);
+	    tputs(tcstr[cap], 1, putframe);
 	    break;
 	case 1:
 	    if (!dontcount) {
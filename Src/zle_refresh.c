@@ -32,14 +32,98 @@
 
 #ifdef HAVE_SELECT
 #define SELECT_ADD_COST(X)	cost += X
-#define zputc(a, b)		putc(a, b), cost++
-#define zwrite(a, b, c, d)	fwrite(a, b, c, d), cost += (b * c)
+#define zputc(a, b)		putframe(a), cost++
+#define zwrite(a, b, c, d)	framewrite(a, (b) * (c)), cost += (b * c)
 #else
 #define SELECT_ADD_COST(X)
-#define zputc(a, b)		putc(a, b)
-#define zwrite(a, b, c, d)	fwrite(a, b, c, d)
+#define zputc(a, b)		putframe(a)
+#define zwrite(a, b, c, d)	framewrite(a, (b) * (c))
 #endif
 
+/* Output produced while the screen is being updated is collected in  *
+ * framebuf rather than going through stdio, and is handed to the    *
+ * terminal with as few write()s as possible once the update is over. *
+ * On a slow link this saves a packet per tputs() burst.              */
+
+static char *framebuf;		/* output collected for the current frame   */
+static int framesz,		/* allocated size of framebuf		    */
+    framelen,			/* number of bytes in framebuf		    */
+    inframe;			/* non-zero while a frame is being built    */
+
+/* Start collecting output for a screen update. */
+
+static void
+startframe(void)
+{
+#ifndef WINNT
+    fflush(shout);
+    framelen = 0;
+    inframe = 1;
+#endif /* WINNT */
+}
+
+/* Write out everything collected since startframe(). */
+
+static void
+endframe(void)
+{
+    char *p = framebuf;
+    int n, left = framelen;
+
+    if (!inframe) {
+	fflush(shout);
+	return;
+    }
+    inframe = 0;
+    fflush(shout);
+    zlerefreshes++;
+    zlerefreshbytes += framelen;
+    while (left > 0) {
+	if ((n = write(fileno(shout), p, left)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    break;
+	}
+	zlerefreshwrites++;
+	p += n;
+	left -= n;
+    }
+    framelen = 0;
+}
+
+static void
+framewrite(char *s, int len)
+{
+    if (!inframe) {
+	fwrite(s, len, 1, shout);
+	return;
+    }
+    if (framelen + len > framesz) {
+	while (framelen + len > framesz)
+	    framesz = framesz ? framesz * 2 : 1024;
+	framebuf = realloc(framebuf, framesz);
+    }
+    memcpy(framebuf + framelen, s, len);
+    framelen += len;
+}
+
+/* Output a single character, for the termcap routines. */
+
+/**/
+int
+putframe(int c)
+{
+    if (inframe && framelen < framesz)
+	framebuf[framelen++] = c;
+    else if (inframe) {
+	char ch = c;
+
+	framewrite(&ch, 1);
+    } else
+	putshout(c);
+    return 0;
+}
+
 /* Oct/Nov 94: <mason> some code savagely redesigned to fix several bugs -
    refreshline() & tc_rightcurs() majorly rewritten; refresh() fixed -
    I've put my fingers into just about every routine in here -
@@ -210,7 +294,9 @@ refresh(void)
     unsigned char *s,		/* pointer into the video buffer	     */
 	*t,			/* pointer into the real buffer		     */
 	*sen,			/* pointer to end of the video buffer (eol)  */
-	*scs;			/* pointer to cursor position in real buffer */
+	*scs,			/* pointer to cursor position in real buffer */
+	*gs,			/* pointer to the gap in the real buffer     */
+	*tend;			/* pointer to end of the real buffer	     */
     char **qbuf;		/* tmp					     */
 
     /* If this is called from listmatches() (indirectly via trashzle()), and *
@@ -220,6 +306,7 @@ refresh(void)
     if (inlist)
 	return;
 
+    startframe();
     if (clearlist && listshown) {
 	if (tccan(TCCLEAREOD)) {
 	    int ovln = vln, ovcs = vcs;
@@ -299,7 +386,6 @@ refresh(void)
 	    vcs = 0;
 	    moveto(0, pptw);
 	}
-	fflush(shout);
 	clearf = clearflag;
     } else if (winw != columns || rwinh != lines)
 	resetvideo();
@@ -319,7 +405,9 @@ refresh(void)
 #endif
 	cs = 0;
     }
-    scs = line + cs;
+    scs = line + cs + (cs < gapcs ? 0 : gaplen);
+    gs = line + gapcs;
+    tend = line + ll + gaplen;
     numscrolls = 0;
 
 /* first, we generate the video line buffers so we know what to put on
@@ -332,7 +420,9 @@ refresh(void)
     s = (unsigned char *)(nbuf[ln = 0] + pptw);
     t = line;
     sen = (unsigned char *)(*nbuf + winw);
-    for (; t < line+ll; t++) {
+    for (; t < tend; t++) {
+	if (t == gs && (t += gaplen) == tend)	/* skip the gap */
+	    break;
 	if (t == scs)			/* if cursor is here, remember it */
 	    nvcs = s - (unsigned char *)(nbuf[nvln = ln]);
 
@@ -375,7 +465,7 @@ refresh(void)
 	nvln++;
     }
 
-    if (t != line + ll)
+    if (t != tend)
 	more_end = 1;
 
     if (statusline) {
@@ -541,7 +631,7 @@ individually */
     onumscrolls = numscrolls;
     if (nlnct > vmaxln)
 	vmaxln = nlnct;
-    fflush(shout);		/* make sure everything is written out */
+    endframe();			/* make sure everything is written out */
 
     /* if we have a new list showing, note it; if part of the list has been
     overwritten, redisplay it. */
@@ -937,7 +1027,7 @@ tc_downcurs(int ct)
 void
 tcout(int cap)
 {
-    tputs(tcstr[cap], 1, putshout);
+    tputs(tcstr[cap], 1, putframe);
     SELECT_ADD_COST(tclen[cap]);
 }
 
@@ -948,7 +1038,7 @@ tcoutarg(int cap, int arg)
     char *result;
 
     result = tgoto(tcstr[cap], arg, arg);
-    tputs(result, 1, putshout);
+    tputs(result, 1, putframe);
     SELECT_ADD_COST(strlen(result));
 }
 
@@ -986,9 +1076,9 @@ singlerefresh(void)
     nlnct = 1;
 /* generate the new line buffer completely */
     for (vsiz = 1 + pptw, t0 = 0; t0 != ll; t0++, vsiz++)
-	if (line[t0] == '\t')
+	if (zlechar(t0) == '\t')
 	    vsiz = (vsiz | 7) + 1;
-	else if (icntrl(line[t0]))
+	else if (icntrl(zlechar(t0)))
 	    vsiz++;
     vbuf = (char *)zalloc(vsiz);
 
@@ -1005,20 +1095,20 @@ singlerefresh(void)
     vp = vbuf + pptw;
 
     for (t0 = 0; t0 != ll; t0++) {
-	if (line[t0] == '\t')
+	if (zlechar(t0) == '\t')
 	    for (*vp++ = ' '; (vp - vbuf) & 7; )
 		*vp++ = ' ';
-	else if (line[t0] == '\n') {
+	else if (zlechar(t0) == '\n') {
 	    *vp++ = '\\';
 	    *vp++ = 'n';
-	} else if (line[t0] == 0x7f) {
+	} else if (zlechar(t0) == 0x7f) {
 	    *vp++ = '^';
 	    *vp++ = '?';
-	} else if (icntrl(line[t0])) {
+	} else if (icntrl(zlechar(t0))) {
 	    *vp++ = '^';
-	    *vp++ = line[t0] | '@';
+	    *vp++ = zlechar(t0) | '@';
 	} else
-	    *vp++ = line[t0];
+	    *vp++ = zlechar(t0);
 	if (t0 == cs)
 	    nvcs = vp - vbuf - 1;
     }
@@ -1075,7 +1165,7 @@ singlerefresh(void)
     qbuf = nbuf;
     nbuf = obuf;
     obuf = qbuf;
-    fflush(shout);		/* make sure everything is written out */
+    endframe();			/* make sure everything is written out */
 }
 
 /**/
@@ -1107,10 +1197,13 @@ singmoveto(int pos)
 void
 genprompts(void)
 {
+    double t = tracetime();
+
     zfree(lpptbuf, lpptlen);
     zfree(rpptbuf, rpptlen);
     lpptbuf = putprompt(lpmpt, &lpptlen, &pptw, 1);
     pmpt_attr = txtchange;
     rpptbuf = putprompt(rpmpt, &rpptlen, &rpw, 1);
     rpmpt_attr = txtchange;
+    endprompttimes(t);
 }
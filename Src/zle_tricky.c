@@ -1340,6 +1340,70 @@ quotename(const char *s, char **e, char *te, int *pl)
     return buf;
 }
 
+/* If COMPTIMEOUT is set, generating the list of matches is polled every *
+ * COMPPOLL candidates.  When the time budget is used up, generation    *
+ * stops and we go on with the matches found so far; when a key has     *
+ * been typed, the completion is abandoned so that the key can be       *
+ * handled at once.  compcancel says which of these happened.           */
+
+#define COMPPOLL 64
+
+#define COMPC_KEY  1
+#define COMPC_TIME 2
+
+static int compcancel, comppoll;
+static long comptmout;
+static struct timeval compstart;
+
+/* Start the clock for a new list of matches. */
+
+static void
+startcompcheck(void)
+{
+    struct timezone dummy_tz;
+
+    compcancel = comppoll = 0;
+    if ((comptmout = getiparam("COMPTIMEOUT")) > 0)
+	gettimeofday(&compstart, &dummy_tz);
+}
+
+/* Check if generating the matches should stop.  This sets errflag, *
+ * which makes the generating loops give up.                        */
+
+static int
+compcheck(void)
+{
+    struct timeval now;
+    struct timezone dummy_tz;
+#ifdef FIONREAD
+    int val = 0;
+#endif
+
+    if (comptmout <= 0)
+	return 0;
+    if (!compcancel) {
+	if (++comppoll < COMPPOLL)
+	    return 0;
+	comppoll = 0;
+#ifdef FIONREAD
+	ioctl(SHTTY, FIONREAD, (char *)&val);
+	if (val)
+	    compcancel = COMPC_KEY;
+	else
+#endif
+	{
+	    gettimeofday(&now, &dummy_tz);
+	    if ((now.tv_sec - compstart.tv_sec) * 100 +
+		(now.tv_usec - compstart.tv_usec) / 10000 >= comptmout)
+		compcancel = COMPC_TIME;
+	}
+	if (!compcancel)
+	    return 0;
+    }
+    errflag = 1;
+    return 1;
+}
+
 /* This adds a match to the list of matches.  The string to add is given   *
  * in s, the type of match is given in the global variable addwhat and     *
  * the parameter t (if not NULL) is a pointer to a hash node node which    *
@@ -1372,6 +1436,9 @@ addmatch(char *s, char *t)
  *          (things with `~' of `=' at the beginning, ...).
  */
 
+    if (compcheck())
+	return;
+
     /* Just to make the code cleaner */
     hn = (HashNode) t;
     pm = (Param) t;
@@ -2044,6 +2111,166 @@ getreal(char *str)
     return ztrdup(str);
 }
 
+/* The names found by the last directory read of gen_matches_files() *
+ * which could be cached.  They are the files that passed the dot,    *
+ * prefix, suffix and type tests against the prefix in dcpre and the  *
+ * suffix in dcsuf; completing a longer prefix or suffix in the same, *
+ * unmodified directory can then narrow this list instead of reading  *
+ * the directory and stat()ing it again.                              *
+ * The directory is identified by device and inode, so a change of    *
+ * the current directory is no problem.  dcmodes holds the lstat()    *
+ * and stat() modes of each name as far as they are known.            */
+
+static char **dcnames, *dcpre, *dcsuf;
+static int *dcmodes;
+static dev_t dcdev;
+static ino_t dcino;
+static time_t dcmtime;
+static int dcflags;
+
+#define DC_DIRS  1
+#define DC_ALL   2
+#define DC_DOTS  4
+#define DC_ICASE 8
+
+/* The types of the files found by gen_matches_files() for the current *
+ * list of matches, keyed by the path ztat() will see.  Inserting or    *
+ * listing the matches looks here before stat()ing them again.          */
+
+static HashTable ftypetab;
+
+#define FTYPETABSIZE 127
+
+static void
+freeftypenode(HashNode hn)
+{
+    zsfree(hn->nam);
+    zfree(hn, sizeof(struct ftype));
+}
+
+/* Forget the file types of the last list of matches. */
+
+static void
+emptyftypes(void)
+{
+    if (ftypetab && ftypetab->ct)
+	emptyhashtable(ftypetab, FTYPETABSIZE);
+}
+
+/* Remember the type of the file n in the directory being completed.  *
+ * This is only worth it if the types are shown when listing; a single *
+ * match costs just one stat() when it is inserted.                    */
+
+static void
+addftype(char *n, int lmode, int smode)
+{
+    Ftype ft;
+
+    if ((!lmode && !smode) || unset(LISTTYPES))
+	return;
+    if (!ftypetab) {
+	ftypetab = newhashtable(FTYPETABSIZE);
+
+	ftypetab->hash        = hasher;
+	ftypetab->emptytable  = NULL;
+	ftypetab->filltable   = NULL;
+	ftypetab->addnode     = addhashnode;
+	ftypetab->getnode     = gethashnode2;
+	ftypetab->getnode2    = gethashnode2;
+	ftypetab->removenode  = removehashnode;
+	ftypetab->disablenode = NULL;
+	ftypetab->enablenode  = NULL;
+	ftypetab->freenode    = freeftypenode;
+	ftypetab->printnode   = NULL;
+#ifdef ZSH_HASH_DEBUG
+	ftypetab->printinfo   = printhashtabinfo;
+	ftypetab->tablename   = ztrdup("ftypetab");
+#endif
+    }
+    ft = (Ftype) zcalloc(sizeof *ft);
+    ft->lmode = lmode;
+    ft->smode = smode;
+    ftypetab->addnode(ftypetab,
+		      tricat((prpre && *prpre) ? prpre : "./", n, ""), ft);
+}
+
+/* Test a file name against the file prefix and suffix (or the pattern). */
+
+static int
+filenametest(char *n)
+{
+    char *e;
+    int test;
+
+    if (filecomp)
+	/* If we have a pattern for the filename check, use it. */
+	return domatch(n, filecomp, 0);
+
+    /* Otherwise use the prefix and suffix strings directly. */
+    e = n + strlen(n) - fsl;
+#ifndef WINNT
+    if ((test = !strncmp(n, fpre, fpl)))
+	test = !strcmp(e, fsuf);
+#else
+    if (!isset(WINNTIGNORECASE)) {
+	if ((test = !strncmp(n, fpre, fpl)))
+	    test = !strcmp(e, fsuf);
+    }
+    else {
+	if ((test = !strnicmp(n, fpre, fpl)))
+	    test = !stricmp(e, fsuf);
+    }
+#endif /* WINNT */
+    return test;
+}
+
+/* Add a file of the right type to the matches, checking the path *
+ * suffix first if there is one.  p is the path buffer, which     *
+ * already contains the file name, l a scratch list for globbing  *
+ * and ns is non-zero if a `*' has to be appended for globbing.   */
+
+static void
+addfilematch(char *n, char *p, LinkList l, int ns)
+{
+    if (*psuf) {
+	/* We have to test for a path suffix. */
+	int o = strlen(p), tt;
+
+	/* Append it to the path buffer. */
+	strcpy(p + o, psuf);
+
+	/* Do we have to use globbing? */
+	if (ispattern || (ns && isset(GLOBCOMPLETE))) {
+	    /* Yes, so append a `*' if needed. */
+	    if (ns) {
+		int tl = strlen(p);
+
+		p[tl] = Star;
+		p[tl + 1] = '\0';
+	    }
+	    /* Do the globbing... */
+	    remnulargs(p);
+	    addlinknode(l, p);
+	    globlist(l);
+	    /* And see if that produced a filename. */
+	    tt = nonempty(l);
+	    while (ugetnode(l));
+	} else
+	    /* Otherwise just check, if we have access *
+	     * to the file.                            */
+	    tt = !access(p, F_OK);
+
+	p[o] = '\0';
+	if (tt)
+	    /* Ok, we can add the filename to the *
+	     * list of matches.                   */
+	    addmatch(dupstring(n), NULL);
+    } else
+	/* We want all files, so just add the name *
+	 * to the matches.                         */
+	addmatch(dupstring(n), NULL);
+}
+
 /* This reads a directory and adds the files to the list of  *
  * matches.  The parameters say which files should be added. */
 
@@ -2052,10 +2279,11 @@ void
 gen_matches_files(int dirs, int execs, int all)
 {
     DIR *d;
-    struct stat buf;
-    char *n, p[PATH_MAX], *q = NULL, *e;
-    LinkList l = NULL;
-    int ns = 0, ng = opts[NULLGLOB], test, aw = addwhat;
+    struct stat buf, dbuf;
+    char *n, p[PATH_MAX], *q = NULL, *dir, **dp;
+    LinkList l = NULL, dl = NULL;
+    LinkNode nd;
+    int ns = 0, ng = opts[NULLGLOB], aw = addwhat, flags, ct, typ, *mp;
 
     addwhat = execs ? -8 : -5;
     opts[NULLGLOB] = 1;
@@ -2071,98 +2299,134 @@ gen_matches_files(int dirs, int execs, int all)
 	dirs = 1;
 	all = execs = 0;
     }
+    dir = (prpre && *prpre) ? prpre : ".";
+    /* If we search only special files, prepare a path buffer for stat. */
+    if (!all && prpre) {
+	strcpy(p, prpre);
+	q = p + strlen(prpre);
+    }
+    flags = (dirs ? DC_DIRS : 0) | (all ? DC_ALL : 0) |
+	((*fpre == '.' || isset(GLOBDOTS)) ? DC_DOTS : 0);
+#ifdef WINNT
+    if (isset(WINNTIGNORECASE))
+	flags |= DC_ICASE;
+#endif /* WINNT */
+
+    /* The cache can only be used for prefix matching and not for  *
+     * executables, whose mode can change without the directory   *
+     * being touched.                                              */
+    if (filecomp || execs || stat(dir, &dbuf) < 0)
+	dbuf.st_ino = 0;
+    else if (dcnames && dcdev == dbuf.st_dev && dcino == dbuf.st_ino &&
+	     dcmtime == dbuf.st_mtime && dcflags == flags &&
+	     strpfx(dcpre, fpre) && strsfx(dcsuf, fsuf)) {
+	/* Nothing has changed since we last read the directory for a *
+	 * prefix and suffix of the current ones, so any name wanted  *
+	 * now is in that list; just narrow it.                       */
+	for (dp = dcnames, mp = dcmodes; *dp && !errflag; dp++, mp += 2)
+	    if (filenametest(*dp)) {
+		if (q)
+		    strcpy(q, *dp);
+		addftype(*dp, mp[0], mp[1]);
+		addfilematch(*dp, p, l, ns);
+	    }
+	opts[NULLGLOB] = ng;
+	addwhat = aw;
+	return;
+    }
+    /* Remember the names found if the directory can be cached.  A *
+     * directory changed within the current second is not cached,  *
+     * since a further change could leave its mtime the same.      */
+    if (dbuf.st_ino && dbuf.st_mtime < time(NULL))
+	dl = newlinklist();
+
     /* Open directory. */
-    if ((d = opendir((prpre && *prpre) ? prpre : "."))) {
-	/* If we search only special files, prepare a path buffer for stat. */
-	if (!all && prpre) {
-	    strcpy(p, prpre);
-	    q = p + strlen(prpre);
-	}
+    if ((d = opendir(dir))) {
 	/* Fine, now read the directory. */
-	while ((n = zreaddir(d)) && !errflag) {
+	while ((n = zreaddirtype(d, &typ)) && !compcheck() && !errflag) {
 	    /* Ignore `.' and `..'. */
 	    if (n[0] == '.' && (n[1] == '\0' || (n[1] == '.' && n[2] == '\0')))
 		continue;
 	    /* Ignore files beginning with `.' unless the thing we found on *
 	     * the command line also starts with a dot or GLOBDOTS is set.  */
 	    if (*n != '.' || *fpre == '.' || isset(GLOBDOTS)) {
-		if (filecomp)
-		    /* If we have a pattern for the filename check, use it. */
-		    test = domatch(n, filecomp, 0);
-		else {
-		    /* Otherwise use the prefix and suffix strings directly. */
-		    e = n + strlen(n) - fsl;
-#ifndef WINNT
-		    if ((test = !strncmp(n, fpre, fpl)))
-			test = !strcmp(e, fsuf);
-#else
-		    if (!isset(WINNTIGNORECASE)) {
-			if ((test = !strncmp(n, fpre, fpl)))
-			    test = !strcmp(e, fsuf);
-		    }
-		    else {
-			if ((test = !strnicmp(n, fpre, fpl)))
-			    test = !stricmp(e, fsuf);
-		    }
-#endif /* WINNT */
-		}
 		/* Filename didn't match? */
-		if (!test)
+		if (!filenametest(n))
 		    continue;
+		/* What the directory told us about the type is what *
+		 * lstat() would say, but for anything but a symbolic *
+		 * link that is also what stat() says.                */
+		mp = (int *) ncalloc(2 * sizeof(int));
+		mp[0] = (typ == S_IFREG) ? 0 : typ;
+#ifdef S_IFLNK
+		mp[1] = (typ == S_IFLNK) ? 0 : typ;
+#else
+		mp[1] = typ;
+#endif
 		if (!all) {
 		    /* We still have to check the file type, so prepare *
 		     * the path buffer by appending the filename.       */
 		    strcpy(q, n);
-		    /* And do the stat. */
-		    if (stat(p, &buf) < 0)
+		    /* If the type is known and we need no mode bits, *
+		     * there is no need for the stat.                 */
+		    if (mp[1] && (mp[1] != S_IFREG || !execs))
+			buf.st_mode = mp[1];
+#if defined(HAVE_FSTATAT) && defined(HAVE_DIRFD)
+		    else if (fstatat(dirfd(d), unmeta(n), &buf, 0) < 0)
+			continue;
+#else
+		    else if (stat(p, &buf) < 0)
 			continue;
+#endif
+		    else {
+			mp[1] = buf.st_mode;
+			if (typ == S_IFREG)
+			    mp[0] = buf.st_mode;
+		    }
 		}
 		if (all ||
 		    (dirs && (buf.st_mode & S_IFMT) == S_IFDIR) ||
 		    (execs && ((buf.st_mode & (S_IFMT | S_IEXEC))
 		      == (S_IFREG | S_IEXEC)))) {
 		    /* If we want all files or the file has the right type... */
-		    if (*psuf) {
-			/* We have to test for a path suffix. */
-			int o = strlen(p), tt;
-
-			/* Append it to the path buffer. */
-			strcpy(p + o, psuf);
-
-			/* Do we have to use globbing? */
-			if (ispattern || (ns && isset(GLOBCOMPLETE))) {
-			    /* Yes, so append a `*' if needed. */
-			    if (ns) {
-				int tl = strlen(p);
-
-				p[tl] = Star;
-				p[tl + 1] = '\0';
-			    }
-			    /* Do the globbing... */
-			    remnulargs(p);
-			    addlinknode(l, p);
-			    globlist(l);
-			    /* And see if that produced a filename. */
-			    tt = nonempty(l);
-			    while (ugetnode(l));
-			} else
-			    /* Otherwise just check, if we have access *
-			     * to the file.                            */
-			    tt = !access(p, F_OK);
-
-			p[o] = '\0';
-			if (tt)
-			    /* Ok, we can add the filename to the *
-			     * list of matches.                   */
-			    addmatch(dupstring(n), NULL);
-		    } else
-			/* We want all files, so just add the name *
-			 * to the matches.                         */
-			addmatch(dupstring(n), NULL);
+		    if (dl) {
+			addlinknode(dl, n = dupstring(n));
+			addlinknode(dl, mp);
+		    }
+		    addftype(n, mp[0], mp[1]);
+		    addfilematch(n, p, l, ns);
 		}
 	    }
 	}
 	closedir(d);
+
+	if (dl && !errflag) {
+	    /* Replace the cached list with the one just built. */
+	    if (dcnames) {
+		for (ct = 0; dcnames[ct]; ct++);
+		zfree(dcmodes, 2 * ct * sizeof(int));
+		freearray(dcnames);
+	    }
+	    zsfree(dcpre);
+	    zsfree(dcsuf);
+	    for (ct = 0, nd = firstnode(dl); nd; incnode(nd), ct++);
+	    ct /= 2;
+	    dp = dcnames = (char **)zalloc((ct + 1) * sizeof(char *));
+	    mp = dcmodes = (int *)zalloc(2 * ct * sizeof(int));
+	    for (nd = firstnode(dl); nd; incnode(nd)) {
+		*dp++ = ztrdup((char *)getdata(nd));
+		incnode(nd);
+		memcpy(mp, getdata(nd), 2 * sizeof(int));
+		mp += 2;
+	    }
+	    *dp = NULL;
+	    dcpre = ztrdup(fpre);
+	    dcsuf = ztrdup(fsuf);
+	    dcdev = dbuf.st_dev;
+	    dcino = dbuf.st_ino;
+	    dcmtime = dbuf.st_mtime;
+	    dcflags = flags;
+	}
     }
     opts[NULLGLOB] = ng;
     addwhat = aw;
@@ -2211,8 +2475,10 @@ docompletion(char *s, int lst, int incmd, int untokenized)
 
 	/* Make sure we have the completion list and compctl. */
 	if(makecomplist(s, incmd, &delit, &compadd, untokenized)) {
-	    /* Error condition: feeeeeeeeeeeeep(). */
-	    feep();
+	    /* Error condition: feeeeeeeeeeeeep(), unless the user has *
+	     * already typed the next key.                             */
+	    if (compcancel != COMPC_KEY)
+		feep();
 	    clearlist = 1;
 	    goto compend;
 	}
@@ -2287,11 +2553,14 @@ makecomplist(char *s, int incmd, int *delit, int *compadd, int untokenized)
     char *p, *sd = NULL, *tt, *s1, *s2, *os = NULL;
     unsigned char *ol = NULL;
 
+    startcompcheck();
+
     /* If we already have a list from a previous execution of this *
      * function, skip the list building code.                      */
     if (validlist)
 	return !nmatches;
 
+    emptyftypes();
     os = dupstring(s);
     ol = (unsigned char *)dupstring((char *)line);
 
@@ -2869,7 +3138,7 @@ makecomplist(char *s, int incmd, int *delit, int *compadd, int untokenized)
 	    /* This flag allows us to use read -l and -c. */
 	    inzlefunc = 1;
 	    /* Call the function. */
-	    doshfunc(list, args, 0, 1);
+	    doshfunc(cc->func, list, args, 0, 1);
 	    inzlefunc = 0;
 	    /* And get the result from the reply parameter. */
 	    if ((r = get_user_var("reply")))
@@ -3002,6 +3271,10 @@ makecomplist(char *s, int incmd, int *delit, int *compadd, int untokenized)
 	/* Add the two types of aliases. */
 	dumphashtable(aliastab, t | (cc->mask & (CC_DISCMDS|CC_EXCMDS)));
 
+    /* If we ran out of time, use what we have got so far. */
+    if (compcancel == COMPC_TIME)
+	errflag = 0;
+
     /* If we have no matches, ignore fignore. */
     if (empty(matches)) {
 	matches = fmatches;
@@ -3047,6 +3320,10 @@ makecomplist(char *s, int incmd, int *delit, int *compadd, int untokenized)
     if ((nmatches || expl) && !errflag)
 	return 0;
 
+    /* Don't bother with xor'ed completions when a key is waiting. */
+    if (compcancel == COMPC_KEY)
+	return 1;
+
     if ((isf || cc->xor) && !parampre) {
 	/* We found no matches, but there is a xor'ed completion: *
 	 * fine, so go back and continue with that compctl.       */
@@ -3107,6 +3384,7 @@ invalidatelist(void)
 	zsfree(firstm);
 	if (ccmain != &cc_dummy)
 	    freecompctl(ccmain);
+	emptyftypes();
     }
     menucmp = showinglist = validlist = 0;
     menucur = NULL;
@@ -3309,6 +3587,8 @@ int
 ztat(char *nam, struct stat *buf, int ls)
 {
     char b[PATH_MAX], *p;
+    Ftype ft;
+    int m;
 
     for (p = b; p < b + sizeof(b) - 1 && *nam; nam++)
 	if (*nam == '\\' && nam[1])
@@ -3317,6 +3597,14 @@ ztat(char *nam, struct stat *buf, int ls)
 	    *p++ = *nam;
     *p = '\0';
 
+    /* If the file was found when generating the matches, we may *
+     * already know its mode.  Only st_mode is filled in then,   *
+     * but that is all our callers look at.                      */
+    if (ftypetab && (ft = (Ftype) ftypetab->getnode(ftypetab, b)) &&
+	(m = ls ? ft->lmode : ft->smode)) {
+	buf->st_mode = m;
+	return 0;
+    }
     return ls ? lstat(b, buf) : stat(b, buf);
 }
 
@@ -40,19 +40,68 @@ sizeline(int sz)
 	line = (unsigned char *)realloc(line, (linesz *= 4) + 2);
 }
 
+/* Nonzero if the command being run may leave the gap open. */
+
+static int gapok;
+
+/* Move the gap to pos and make it at least ct chars long.  A gap  *
+ * that has to grow gets a quarter of the line on top, so that a   *
+ * long run of typing only moves the tail once in a while.         */
+
+static void
+movegap(int pos, int ct)
+{
+    if (gaplen) {
+	if (pos < gapcs)
+	    memmove(line + pos + gaplen, line + pos, gapcs - pos);
+	else if (pos > gapcs)
+	    memmove(line + gapcs, line + gapcs + gaplen, pos - gapcs);
+    }
+    gapcs = pos;
+    if (gaplen < ct) {
+	int ngap = ct + 64 + ll / 4;
+
+	sizeline(ll + ngap);
+	memmove(line + pos + ngap, line + pos + gaplen, ll - pos);
+	gaplen = ngap;
+    }
+}
+
+/* put the line back in one piece */
+
+/**/
+void
+closegap(void)
+{
+    if (gaplen) {
+	memmove(line + gapcs, line + gapcs + gaplen, ll - gapcs);
+	gaplen = 0;
+	line[ll] = '\0';
+    }
+}
+
+static void trackins _((int pos, int ct));
+static void trackdel _((int pos, int ct));
+
 /* insert space for ct chars at cursor position */
 
 /**/
 void
 spaceinline(int ct)
 {
-    int i;
-
-    sizeline(ct + ll);
-    for (i = ll; --i >= cs;)
-	line[i + ct] = line[i];
-    ll += ct;
-    line[ll] = '\0';
+    trackins(cs, ct);
+    if (gapok) {
+	movegap(cs, ct);
+	gapcs += ct;
+	gaplen -= ct;
+	ll += ct;
+    } else {
+	sizeline(ct + ll);
+	if (ll > cs)
+	    memmove(line + cs + ct, line + cs, ll - cs);
+	ll += ct;
+	line[ll] = '\0';
+    }
 
     if (mark > cs)
 	mark += ct;
@@ -62,14 +111,24 @@ spaceinline(int ct)
 void
 shiftchars(int to, int cnt)
 {
+    if (to + cnt > ll)
+	cnt = ll - to;
+    trackdel(to, cnt);
+
     if (mark >= to + cnt)
 	mark -= cnt;
     else if (mark > to)
 	mark = to;
 
-    while (to + cnt < ll) {
-	line[to] = line[to + cnt];
-	to++;
+    if (gapok) {
+	movegap(to, 0);
+	gaplen += cnt;
+	ll -= cnt;
+	return;
+    }
+    if (to + cnt < ll) {
+	memmove(line + to, line + to + cnt, ll - to - cnt);
+	to = ll - cnt;
     }
     line[ll = to] = '\0';
 }
@@ -194,7 +253,7 @@ findbol(void)
 {
     int x = cs;
 
-    while (x > 0 && line[x - 1] != '\n')
+    while (x > 0 && zlechar(x - 1) != '\n')
 	x--;
     return x;
 }
@@ -205,7 +264,7 @@ findeol(void)
 {
     int x = cs;
 
-    while (x != ll && line[x] != '\n')
+    while (x != ll && zlechar(x) != '\n')
 	x++;
     return x;
 }
@@ -218,52 +277,334 @@ findline(int *a, int *b)
     *b = findeol();
 }
 
+/* How the changes made by a command are recorded for undo: not *
+ * at all, by spaceinline() and shiftchars() as they are made    *
+ * (for commands flagged ZLE_SIMPLE), or by comparing the line   *
+ * afterwards with a copy taken in lastline beforehand.  The     *
+ * comparison also spans a whole vi insert, since undo records   *
+ * are not made then.                                            */
+
+#define EDIT_UNTRACKED	0
+#define EDIT_TRACKED	1
+#define EDIT_COMPARE	2
+
+static int edittrack;
+
 static int lastlinelen;
 
+/* The change tracked so far: undodel chars at undopf, kept in *
+ * undodeltext, were replaced by the undoins chars now there.  */
+
+static int undopending, undopf, undodel, undoins, undodelsz;
+static char *undodeltext;
+
+/* memory used by the undo records */
+
+static int undomem;
+
 /**/
 void
 initundo(void)
 {
-    int t0;
-
-    for (t0 = 0; t0 != UNDOCT; t0++)
-	undos[t0].change = NULL;
-    undoct = 0;
-    lastline = (unsigned char *)zalloc(lastlinelen = linesz + 1);
-    memcpy((char *)lastline, (char *)line, ll);
-    lastll = ll;
+    undolist = curundo = NULL;
+    undomem = 0;
+    edittrack = EDIT_UNTRACKED;
+    undopending = 0;
     lastcs = cs;
 }
 
+/* Free ue and all the records after it. */
+
+static void
+freeundolist(struct undoent *ue)
+{
+    struct undoent *next;
+
+    if (!ue)
+	return;
+    if (ue->prev)
+	ue->prev->next = NULL;
+    else
+	undolist = NULL;
+    for (; ue; ue = next) {
+	next = ue->next;
+	undomem -= sizeof(*ue) + ue->size;
+	zfree(ue->text, ue->size);
+	zfree(ue, sizeof(*ue));
+    }
+}
+
 /**/
 void
-addundo(void)
+freeundo(void)
+{
+    freeundolist(undolist);
+    curundo = NULL;
+    if (lastline)
+	zfree(lastline, lastlinelen);
+    lastline = NULL;
+    lastlinelen = 0;
+    if (undodeltext)
+	zfree(undodeltext, undodelsz);
+    undodeltext = NULL;
+    undodelsz = 0;
+}
+
+/* Copy n chars of the line from pos to buf, allowing for the gap. */
+
+static void
+copyline(char *buf, int pos, int n)
+{
+    int k = gapcs - pos;
+
+    if (k > n)
+	k = n;
+    if (k > 0) {
+	memcpy(buf, (char *)line + pos, k);
+	buf += k;
+	pos += k;
+	n -= k;
+    }
+    if (n > 0)
+	memcpy(buf, (char *)line + pos + gaplen, n);
+}
+
+/* Record that the del chars at pf, which are at deltext, have been  *
+ * replaced by the ins chars now there.  Text typed a character at a *
+ * time goes into one record per word.                               */
+
+static void
+newundo(int pf, int del, char *deltext, int ins)
 {
-    int pf, sf;
-    unsigned char *s, *s2, *t, *t2;
     struct undoent *ue;
 
-    for (s = line, t = lastline;
-	s < line+ll && t < lastline+lastll && *s == *t; s++, t++);
-    if (s == line+ll && t == lastline+lastll)
+    if ((ue = curundo) && !ue->next && (ue->flags & UNDO_SELFINSERT) &&
+	(bindk == z_selfinsert || bindk == z_selfinsertunmeta) &&
+	!del && !ue->del && ue->pref + ue->ins == pf &&
+	!(iblank(zlechar(pf)) && !iblank(zlechar(pf - 1)))) {
+	if (ue->ins + ins > ue->size) {
+	    int nsize = (ue->ins + ins) * 2;
+	    char *ntext = (char *)zalloc(nsize);
+
+	    memcpy(ntext, ue->text, ue->ins);
+	    zfree(ue->text, ue->size);
+	    undomem += nsize - ue->size;
+	    ue->text = ntext;
+	    ue->size = nsize;
+	}
+	copyline(ue->text + ue->ins, pf, ins);
+	ue->ins += ins;
+	ue->ncs = cs;
+    } else {
+	freeundolist(curundo ? curundo->next : undolist);
+	ue = (struct undoent *)zalloc(sizeof(*ue));
+	ue->pref = pf;
+	ue->del = del;
+	ue->ins = ins;
+	ue->cs = lastcs;
+	ue->ncs = cs;
+	ue->flags = (bindk == z_selfinsert || bindk == z_selfinsertunmeta) ?
+	    UNDO_SELFINSERT : 0;
+	ue->text = (char *)zalloc(ue->size = del + ins);
+	memcpy(ue->text, deltext, del);
+	copyline(ue->text + del, pf, ins);
+	undomem += sizeof(*ue) + ue->size;
+	ue->next = NULL;
+	if ((ue->prev = curundo))
+	    curundo->next = ue;
+	else
+	    undolist = ue;
+	curundo = ue;
+	/* keep within UNDOMEM, but always keep the change just made */
+	while (undomem > UNDOMEM && undolist != ue) {
+	    struct undoent *old = undolist;
+
+	    undolist = old->next;
+	    undolist->prev = NULL;
+	    undomem -= sizeof(*old) + old->size;
+	    zfree(old->text, old->size);
+	    zfree(old, sizeof(*old));
+	}
+    }
+    lastcs = cs;
+}
+
+/* Make a record of the change tracked so far, if any. */
+
+static void
+recordundo(void)
+{
+    if (undopending && (undodel || undoins))
+	newundo(undopf, undodel, undodeltext, undoins);
+    undopending = 0;
+}
+
+/* Start tracking a new change at pos, recording any earlier one *
+ * that the new one does not touch.                              */
+
+static void
+starttrack(int pos, int end)
+{
+    if (undopending && (end < undopf || pos > undopf + undoins))
+	recordundo();
+    if (!undopending) {
+	undopending = 1;
+	undopf = pos;
+	undodel = undoins = 0;
+    }
+}
+
+/* ct chars are being inserted at pos. */
+
+static void
+trackins(int pos, int ct)
+{
+    if (edittrack != EDIT_TRACKED || !ct)
+	return;
+    starttrack(pos, pos);
+    undoins += ct;
+}
+
+/* The ct chars at pos are being deleted.  Those not inserted by  *
+ * the change being tracked are saved, so they can be put back.   */
+
+static void
+trackdel(int pos, int ct)
+{
+    int before, after;
+
+    if (edittrack != EDIT_TRACKED || !ct)
 	return;
-    pf = s - line;
-    for (s2 = (unsigned char *)line + ll, t2 = lastline + lastll;
-	 s2 > s && t > t2 && s2[-1] == t2[-1]; s2--, t2--);
-    sf = line+ll - s2;
-    ue = undos + (undoct = (undoct + 1) % UNDOCT);
-    ue->pref = pf;
-    ue->suff = sf;
-    ue->len = t2 - t;
-    ue->cs = lastcs;
-    memcpy(ue->change = (char *)halloc(ue->len), (char *)t, ue->len);
-    if(linesz + 1 > lastlinelen) {
-	free(lastline);
+    starttrack(pos, pos + ct);
+    before = (pos < undopf) ? undopf - pos : 0;
+    after = (pos + ct > undopf + undoins) ? pos + ct - undopf - undoins : 0;
+    if (undodel + before + after > undodelsz) {
+	int nsize = (undodel + before + after) * 2;
+
+	undodeltext = (char *)zrealloc(undodeltext, nsize);
+	undodelsz = nsize;
+    }
+    memmove(undodeltext + before, undodeltext, undodel);
+    copyline(undodeltext, pos, before);
+    copyline(undodeltext + before + undodel, undopf + undoins, after);
+    undodel += before + after;
+    undoins -= ct - before - after;
+    undopf -= before;
+}
+
+/* Copy the line to lastline, to be compared with it afterwards. */
+
+static void
+copyforundo(void)
+{
+    if (ll + 1 > lastlinelen) {
+	if (lastline)
+	    zfree(lastline, lastlinelen);
 	lastline = (unsigned char *)zalloc(lastlinelen = linesz + 1);
     }
     memcpy((char *)lastline, (char *)line, ll);
     lastll = ll;
-    lastcs = cs;
+    edittrack = EDIT_COMPARE;
+}
+
+/* Called before running a command with the ZLE_* flags given. */
+
+/**/
+void
+startedit(int flags)
+{
+    if (!(gapok = flags & ZLE_SIMPLE))
+	closegap();
+    if (flags & ZLE_UNDO)
+	addundo();
+    else if (edittrack == EDIT_UNTRACKED) {
+	if (gapok)
+	    edittrack = EDIT_TRACKED;
+	else
+	    copyforundo();
+    }
+}
+
+/* Called by a command flagged ZLE_SIMPLE that is about to change *
+ * the line other than through spaceinline() and shiftchars().    */
+
+/**/
+void
+slowedit(void)
+{
+    closegap();
+    gapok = 0;
+    if (edittrack == EDIT_TRACKED) {
+	recordundo();
+	copyforundo();
+    }
+}
+
+/* Return the number of chars at the start of a and b that are the *
+ * same, looking at no more than n.  Most of the time the lines are *
+ * long and mostly identical, so compare a block at a time first.   */
+
+static int
+undoprefix(unsigned char *a, unsigned char *b, int n)
+{
+    int i = 0;
+
+    while (n - i >= 64 && !memcmp(a + i, b + i, 64))
+	i += 64;
+    while (i < n && a[i] == b[i])
+	i++;
+    return i;
+}
+
+/* The same for the chars before a and b. */
+
+static int
+undosuffix(unsigned char *a, unsigned char *b, int n)
+{
+    int i = 0;
+
+    while (n - i >= 64 && !memcmp(a - i - 64, b - i - 64, 64))
+	i += 64;
+    while (i < n && a[-i - 1] == b[-i - 1])
+	i++;
+    return i;
+}
+
+/* Record the change made by the last command, if any. */
+
+/**/
+void
+addundo(void)
+{
+    if (edittrack == EDIT_TRACKED)
+	recordundo();
+    else if (edittrack == EDIT_COMPARE) {
+	int pf, sf, min = (ll < lastll) ? ll : lastll;
+
+	closegap();
+	pf = undoprefix(line, lastline, min);
+	if (pf != ll || pf != lastll) {
+	    sf = undosuffix(line + ll, lastline + lastll, min - pf);
+	    newundo(pf, lastll - pf - sf, (char *)lastline + pf,
+		    ll - pf - sf);
+	}
+    }
+    edittrack = EDIT_UNTRACKED;
+}
+
+/* Replace the olen chars at pos in the line by the nlen chars at s, *
+ * for undo and redo.                                                */
+
+/**/
+void
+undochange(int pos, int olen, char *s, int nlen)
+{
+    cs = pos;
+    if (nlen > olen)
+	spaceinline(nlen - olen);
+    else if (olen > nlen)
+	shiftchars(pos, olen - nlen);
+    memcpy((char *)line + pos, s, nlen);
 }
 
 /* Search for needle in haystack.  Haystack is a metafied string while *
@@ -597,6 +597,23 @@ viindent(void)
     vifirstnonblank();
 }
 
+/* Undo the last change, or redo it if it was undone by this command. */
+
+/**/
+void
+viundochange(void)
+{
+    struct undoent *ue = curundo ? curundo->next : undolist;
+
+    if (ue && (ue->flags & UNDO_VIUNDONE))
+	redo();
+    else if ((ue = curundo)) {
+	undo();
+	ue->flags |= UNDO_VIUNDONE;
+    } else
+	feep();
+}
+
 /**/
 void
 viunindent(void)
@@ -619,8 +619,15 @@ struct job {
 #define SP_RUNNING -1		/* fake status for jobs currently running */
 
 struct timeinfo {
-    long ut;                    /* user space time   */
-    long st;                    /* system space time */
+    double ut;                  /* user space time, in seconds          */
+    double st;                  /* system space time, in seconds        */
+    long maxrss;                /* maximum resident set size (kB)       */
+    long majflt;                /* page faults needing I/O              */
+    long minflt;                /* page faults not needing I/O          */
+    long nvcsw;                 /* voluntary context switches           */
+    long nivcsw;                /* involuntary context switches         */
+    long inblock;               /* block input operations               */
+    long oublock;               /* block output operations              */
 };
 
 #define JOBTEXTSIZE 80
@@ -691,6 +698,7 @@ struct hashtable {
     /* HASHTABLE DATA */
     int hsize;			/* size of nodes[]  (number of hash values)   */
     int ct;			/* number of elements                         */
+    int gen;			/* changed whenever nodes are added/removed   */
     HashNode *nodes;		/* array of size hsize                        */
 
 #ifdef ZSH_HASH_DEBUG
@@ -923,6 +931,19 @@ struct schedcmd {
     time_t time;		/* when to run it */
 };
 
+/* phases of the work done before each prompt, *
+ * in the order of the PROMPTTIMES array       */
+
+#define PT_SCANJOBS	0
+#define PT_PRECMD	1
+#define PT_PERIODIC	2
+#define PT_WATCH	3
+#define PT_MAIL		4
+#define PT_SCHED	5
+#define PT_PROMPT	6
+#define PT_TOTAL	7
+#define PT_COUNT	8
+
 
 /***********************************/
 /* Definitions for history control */
@@ -1116,6 +1137,7 @@ enum {
     BEEP,
     BGNICE,
     BRACECCL,
+    BRACKETEDPASTE,
     BSDECHO,
     CDABLEVARS,
     CHASELINKS,
@@ -1166,6 +1188,7 @@ enum {
     MAGICEQUALSUBST,
     MAILWARNING,
     MARKDIRS,
+    MEMFDSUBST,
     MENUCOMPLETE,
     MONITOR,
     MULTIOS,
@@ -1409,6 +1432,32 @@ struct ttyinfo {
 			     global_permalloc(); alloc_stackp--;) return
 #endif
 
+/* Calls to the allocators pass on where they were made from, for the *
+ * allocation profile kept by the mem builtin.  mem.c undoes these.   */
+
+#define zalloc(S)	zalloc_at((S), __FILE__, __LINE__)
+#define zcalloc(S)	zcalloc_at((S), __FILE__, __LINE__)
+#define zrealloc(P,S)	zrealloc_at((P), (S), __FILE__, __LINE__)
+#define ztrdup(S)	ztrdup_at((S), __FILE__, __LINE__)
+#define zfree(P,S)	zfree_at((P), (S), __FILE__, __LINE__)
+#define zsfree(P)	zsfree_at((P), __FILE__, __LINE__)
+#define halloc(S)	halloc_at((S), __FILE__, __LINE__)
+#define hcalloc(S)	hcalloc_at((S), __FILE__, __LINE__)
+#define dupstring(S)	dupstring_at((S), __FILE__, __LINE__)
+#define alloc(S)	alloc_at((S), __FILE__, __LINE__)
+#define ncalloc(S)	ncalloc_at((S), __FILE__, __LINE__)
+
+/* Blocks from zalloc() are often given back with free() or resized *
+ * with realloc(), so those go the same way unless (as on NT) they  *
+ * are already macros for some other allocator.                     */
+
+#ifndef free
+# define free(P)	zfree_at((P), 0, __FILE__, __LINE__)
+#endif
+#ifndef realloc
+# define realloc(P,S)	zrealloc_at((P), (S), __FILE__, __LINE__)
+#endif
+
 /****************/
 /* Debug macros */
 /****************/
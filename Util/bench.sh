@@ -0,0 +1,181 @@
+#!/bin/sh
+#
+# NAME:
+#	bench.sh
+#
+# SYNOPSIS:
+#	bench.sh zsh benchrun [runs]
+#
+# DESCRIPTION:
+#	Runs the benchmark workloads below against the zsh binary given
+#	and writes the results to stdout as JSON, one object per workload
+#	in a "results" array.  The fields of each object are described in
+#	benchrun.c; they are kept stable so that the output of two builds
+#	can be compared directly.  "make bench" runs this on Src/zsh and
+#	leaves the results in bench.json.
+#
+#	The workloads and the data they use are generated afresh in a
+#	temporary directory each time, so every run does the same work.
+#
+
+ZSH=$1
+BENCHRUN=$2
+RUNS=${3-5}
+
+if test ! -x "$ZSH" || test ! -x "$BENCHRUN"; then
+    echo "usage: bench.sh zsh benchrun [runs]" >&2
+    exit 2
+fi
+case $ZSH in /*) ;; *) ZSH=`pwd`/$ZSH ;; esac
+case $BENCHRUN in /*) ;; *) BENCHRUN=`pwd`/$BENCHRUN ;; esac
+
+TMP=${TMPDIR-/tmp}/zshbench.$$
+trap 'rm -rf $TMP' 0 1 2 15
+mkdir $TMP || exit 1
+cd $TMP
+
+# ---- data ----
+
+# a tree of 20 directories of 250 files each
+awk 'BEGIN {
+    for (d = 0; d < 20; d++) {
+	dir = sprintf("tree/d%02d", d)
+	system("mkdir -p " dir)
+	cmd = "cd " dir " && touch"
+	for (f = 0; f < 250; f++)
+	    cmd = cmd sprintf(" f%03d.%s", f, (f % 3) ? "c" : "h")
+	system(cmd)
+    }
+}'
+
+# a 500,000 line history file
+awk 'BEGIN {
+    for (i = 0; i < 500000; i++)
+	printf "echo history line %d | grep -v pattern%d\n", i, i % 97
+}' > history
+
+# a large script: 2000 functions and the code to call them
+awk 'BEGIN {
+    for (i = 0; i < 2000; i++) {
+	printf "func%d() {\n", i
+	printf "    local a=$1 b=${2:-default} c\n"
+	printf "    if [[ $a = *x* ]] && (( ${#b} > %d )); then\n", i % 10
+	printf "\tc=(${(s:,:)b})\n"
+	printf "\tfor x in $c; do echo $x | tr a-z A-Z >/dev/null; done\n"
+	printf "    else\n"
+	printf "\tcase $a in\n"
+	printf "\t    a*) echo a;;\n\t    b*) echo b;;\n\t    *) echo ${a#?};;\n"
+	printf "\tesac\n"
+	printf "    fi\n"
+	printf "    while (( $#c > 0 )); do shift c; done\n"
+	printf "}\n"
+    }
+}' > big.zsh
+
+# ---- workloads ----
+
+cat > glob.zsh <<'EOF'
+cd tree
+repeat 20 {
+    a=(**/*)
+    b=(*/*.h)
+    c=(d1?/f[0-4]*.c)
+}
+EOF
+
+cat > param.zsh <<'EOF'
+s=abcdefgh
+repeat 14 s="$s $s"
+repeat 30 {
+    x=${s#* }
+    y=${s%% *}
+    z=${s#*h*h}
+    w=(${(s: :)s})
+}
+EOF
+
+cat > array.zsh <<'EOF'
+a=()
+i=0
+while (( i < 5000 )); do
+    a[$#a+1]=elt$i
+    (( i++ ))
+done
+repeat 20 b=($a $a)
+EOF
+
+cat > arith.zsh <<'EOF'
+i=0 s=0
+while (( i < 200000 )); do
+    (( s += i * 3 % 7, i++ ))
+done
+EOF
+
+cat > func.zsh <<'EOF'
+f() { return 0 }
+g() { f $1; f $2 }
+i=0
+while (( i < 20000 )); do
+    g a b
+    (( i++ ))
+done
+EOF
+
+# string handling that goes through metafy(), unmetafy(), unmeta(),
+# ztrlen(), ztrcmp() and nicezputs() with long plain strings
+cat > meta.zsh <<'EOF'
+s=/abcdefghijklmnopqrstuvwxyz0123456789
+repeat 5 s=$s$s
+i=0
+while (( i < 2000 )); do
+    hash cmd$i=$s$i
+    (( i++ ))
+done
+repeat 20 whence -v cmd{1..2000} >/dev/null
+repeat 50000 { n=${#s}; [[ -e $s ]] }
+repeat 20 x="$(<big.zsh)"
+EOF
+
+cat > hist.zsh <<'EOF'
+HISTSIZE=500000
+SAVEHIST=500000
+fc -R history
+fc -W history.out
+EOF
+
+# completion and redisplay: list files, complete a path a component at
+# a time, type a long line and move back and forth across it.  Every
+# key must produce some output, since benchrun waits for it.  The wall
+# clock time includes a millisecond's pause after each key, so compare
+# the cpu time here.
+{
+    printf 'ls tree/d0\t\t\025'
+    printf 'ls tree/d1\t1\tf01\t\025'
+    printf 'echo '
+    awk 'BEGIN { for (i = 0; i < 60; i++) printf "word%d ", i }'
+    awk 'BEGIN { for (i = 0; i < 300; i++) printf "\002" }'
+    awk 'BEGIN { for (i = 0; i < 300; i++) printf "\006" }'
+    printf '\025exit\n'
+} > zle.keys
+
+# ---- run ----
+
+echo '{'
+echo "  \"zsh\": \"$ZSH\","
+echo "  \"version\": \"`$ZSH -fc 'echo $ZSH_VERSION'`\","
+echo "  \"date\": \"`date -u '+%Y-%m-%dT%H:%M:%SZ'`\","
+echo "  \"results\": ["
+sep=
+for w in glob param array arith func meta; do
+    printf '%s    ' "$sep"
+    $BENCHRUN -n $RUNS $w $ZSH -f $w.zsh
+    sep=,
+done
+printf ',    '
+$BENCHRUN -n $RUNS hist $ZSH -fi hist.zsh
+printf ',    '
+$BENCHRUN -n $RUNS parse $ZSH -fn big.zsh
+printf ',    '
+TERM=vt100 $BENCHRUN -n $RUNS -k zle.keys zle $ZSH -f
+echo '  ]'
+echo '}'
@@ -0,0 +1,245 @@
+/*
+ * benchrun.c - run and time one benchmark workload for `make bench'
+ *
+ * This file is part of zsh, the Z shell.
+ *
+ * usage: benchrun [ -n runs ] [ -k keyfile ] name command [ arg ... ]
+ *
+ * The command is run the given number of times (default 5) and one
+ * line of JSON is written to standard output with the minimum and
+ * median wall clock time, the median cpu time of the child and its
+ * largest maximum resident set size.  Times are in microseconds.
+ *
+ * With -k, the command is run on a pseudo-terminal and the contents
+ * of keyfile are typed at it one byte at a time, waiting after each
+ * byte until the command has answered with some output, so that each
+ * keystroke is read and displayed separately as it would be by hand.
+ */
+
+#define _XOPEN_SOURCE 600
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+
+#ifndef MAXRUNS
+#define MAXRUNS 100
+#endif
+
+static char *keys;
+static int keylen;
+
+static double
+now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static double
+tvusec(struct timeval *tv)
+{
+    return tv->tv_sec * 1e6 + tv->tv_usec;
+}
+
+static void
+readkeys(char *file)
+{
+    struct stat st;
+    int fd;
+
+    if ((fd = open(file, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+	perror(file);
+	exit(2);
+    }
+    keylen = st.st_size;
+    keys = malloc(keylen + 1);
+    if (!keys || read(fd, keys, keylen) != keylen) {
+	perror(file);
+	exit(2);
+    }
+    close(fd);
+}
+
+/* Wait up to usec microseconds for output on fd and read *
+ * all that is there.  Returns 0 at end of file.          */
+
+static int
+drain(int fd, long usec)
+{
+    char buf[8192];
+    struct timeval tv;
+    fd_set fds;
+    int n, got = 0;
+
+    for (;;) {
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+	tv.tv_sec = usec / 1000000;
+	tv.tv_usec = usec % 1000000;
+	if ((n = select(fd + 1, &fds, NULL, NULL, &tv)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return 0;
+	}
+	if (!n)
+	    return 1;
+	if ((n = read(fd, buf, sizeof buf)) <= 0)
+	    return 0;
+	/* once something has arrived, only take what follows at once */
+	if (!got++)
+	    usec = 1000;
+    }
+}
+
+static pid_t
+startpty(char **argv, int *masterp)
+{
+    int master, slave;
+    char *name;
+    pid_t pid;
+
+    if ((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0 ||
+	grantpt(master) < 0 || unlockpt(master) < 0 ||
+	!(name = ptsname(master))) {
+	perror("pty");
+	exit(2);
+    }
+    if ((pid = fork()) < 0) {
+	perror("fork");
+	exit(2);
+    }
+    if (!pid) {
+	setsid();
+	if ((slave = open(name, O_RDWR)) < 0)
+	    _exit(127);
+	close(master);
+	dup2(slave, 0);
+	dup2(slave, 1);
+	dup2(slave, 2);
+	if (slave > 2)
+	    close(slave);
+	execvp(argv[0], argv);
+	_exit(127);
+    }
+    *masterp = master;
+    return pid;
+}
+
+static int
+runpty(char **argv)
+{
+    int master, i, status;
+    pid_t pid;
+
+    pid = startpty(argv, &master);
+    drain(master, 500000);
+    for (i = 0; i < keylen; i++) {
+	if (write(master, keys + i, 1) != 1)
+	    break;
+	if (!drain(master, 1000000))
+	    break;
+    }
+    /* wait for it to exit, but don't hang if it doesn't */
+    for (i = 0; i < 10 && drain(master, 1000000); i++);
+    close(master);
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+static int
+run(char **argv)
+{
+    int status, fd;
+    pid_t pid;
+
+    if (keys)
+	return runpty(argv);
+    if ((pid = fork()) < 0) {
+	perror("fork");
+	exit(2);
+    }
+    if (!pid) {
+	if ((fd = open("/dev/null", O_RDWR)) >= 0) {
+	    dup2(fd, 0);
+	    dup2(fd, 1);
+	    if (fd > 2)
+		close(fd);
+	}
+	execvp(argv[0], argv);
+	_exit(127);
+    }
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+static int
+dblcmp(const void *a, const void *b)
+{
+    double x = *(double *) a, y = *(double *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+int
+main(int argc, char **argv)
+{
+    double wall[MAXRUNS], cpu[MAXRUNS], t, c;
+    struct rusage ru;
+    long maxrss = 0;
+    int runs = 5, i, opt, status, failed = 0;
+    char *name;
+
+    while ((opt = getopt(argc, argv, "+n:k:")) != -1) {
+	switch (opt) {
+	case 'n':
+	    runs = atoi(optarg);
+	    break;
+	case 'k':
+	    readkeys(optarg);
+	    break;
+	default:
+	    goto usage;
+	}
+    }
+    if (argc - optind < 2 || runs < 1 || runs > MAXRUNS) {
+    usage:
+	fprintf(stderr,
+		"usage: benchrun [-n runs] [-k keyfile] name command [arg ...]\n");
+	return 2;
+    }
+    name = argv[optind++];
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < runs; i++) {
+	getrusage(RUSAGE_CHILDREN, &ru);
+	c = tvusec(&ru.ru_utime) + tvusec(&ru.ru_stime);
+	t = now();
+	status = run(argv + optind);
+	wall[i] = now() - t;
+	getrusage(RUSAGE_CHILDREN, &ru);
+	cpu[i] = tvusec(&ru.ru_utime) + tvusec(&ru.ru_stime) - c;
+	if (ru.ru_maxrss > maxrss)
+	    maxrss = ru.ru_maxrss;
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+	    failed++;
+    }
+    qsort(wall, runs, sizeof(double), dblcmp);
+    qsort(cpu, runs, sizeof(double), dblcmp);
+
+    printf("{\"name\": \"%s\", \"runs\": %d, \"failed\": %d, "
+	   "\"wall_min_us\": %.0f, \"wall_median_us\": %.0f, "
+	   "\"cpu_median_us\": %.0f, \"maxrss_kb\": %ld}\n",
+	   name, runs, failed, wall[0], wall[runs / 2], cpu[runs / 2], maxrss);
+    return failed != 0;
+}
@@ -82,6 +82,9 @@
 /* Define if you have the <utmpx.h> header file.  */
 #undef HAVE_UTMPX_H
 
+/* Define if your system's struct dirent has a member named d_type.  */
+#undef HAVE_DIRENT_D_TYPE
+
 /* Define to be the machine type (microprocessor class or machine model) */
 #undef MACHTYPE
 